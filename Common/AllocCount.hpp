@@ -0,0 +1,102 @@
+#pragma once
+
+/*
+ * count the heap allocations of the whole program, so a benchmark can show allocations per operation.
+ *
+ *     auto before = alloccount::allocations();
+ *     ...
+ *     auto perOp = static_cast<double>(alloccount::allocations() - before) / ops;
+ *
+ * + replaces the global operator new/delete, plain and over-aligned(std::align_val_t, alignas(64) types), single
+ *   and array, throwing and nothrow: include it in one translation unit only(every example in this repo is a
+ *   single .cpp). allocations that don't go through operator new(malloc, mmap) are not counted
+ * + noinline: otherwise gcc sees malloc/free through the inlined operators and reports a bogus
+ *   -Wmismatched-new-delete
+ * + the counter is a relaxed atomic, the examples allocate from several threads
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+namespace alloccount
+{
+
+namespace detail
+{
+inline std::atomic<std::size_t> count{0};
+} // namespace detail
+
+inline std::size_t allocations()
+{
+    return detail::count.load(std::memory_order_relaxed);
+}
+
+} // namespace alloccount
+
+[[gnu::noinline]] void* operator new(std::size_t size)
+{
+    alloccount::detail::count.fetch_add(1, std::memory_order_relaxed);
+    if(auto* p = std::malloc(size == 0 ? 1 : size))
+        return p;
+    throw std::bad_alloc();
+}
+[[gnu::noinline]] void operator delete(void* p) noexcept { std::free(p); }
+[[gnu::noinline]] void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+[[gnu::noinline]] void* operator new(std::size_t size, std::align_val_t align)
+{
+    alloccount::detail::count.fetch_add(1, std::memory_order_relaxed);
+    // aligned_alloc wants a size that is a multiple of the alignment
+    auto alignment = std::max(static_cast<std::size_t>(align), sizeof(void*));
+    if(auto* p = std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment))
+        return p;
+    throw std::bad_alloc();
+}
+[[gnu::noinline]] void operator delete(void* p, std::align_val_t) noexcept { std::free(p); }
+[[gnu::noinline]] void operator delete(void* p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+
+// the array and nothrow forms forward to the ones above
+void* operator new[](std::size_t size) { return ::operator new(size); }
+void* operator new[](std::size_t size, std::align_val_t align) { return ::operator new(size, align); }
+void operator delete[](void* p) noexcept { ::operator delete(p); }
+void operator delete[](void* p, std::size_t) noexcept { ::operator delete(p); }
+void operator delete[](void* p, std::align_val_t align) noexcept { ::operator delete(p, align); }
+void operator delete[](void* p, std::size_t, std::align_val_t align) noexcept { ::operator delete(p, align); }
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+    try
+    {
+        return ::operator new(size);
+    }
+    catch(const std::bad_alloc&)
+    {
+        return nullptr;
+    }
+}
+void* operator new(std::size_t size, std::align_val_t align, const std::nothrow_t&) noexcept
+{
+    try
+    {
+        return ::operator new(size, align);
+    }
+    catch(const std::bad_alloc&)
+    {
+        return nullptr;
+    }
+}
+void* operator new[](std::size_t size, const std::nothrow_t& tag) noexcept { return ::operator new(size, tag); }
+void* operator new[](std::size_t size, std::align_val_t align, const std::nothrow_t& tag) noexcept
+{
+    return ::operator new(size, align, tag);
+}
+void operator delete(void* p, const std::nothrow_t&) noexcept { ::operator delete(p); }
+void operator delete(void* p, std::align_val_t align, const std::nothrow_t&) noexcept { ::operator delete(p, align); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { ::operator delete(p); }
+void operator delete[](void* p, std::align_val_t align, const std::nothrow_t&) noexcept
+{
+    ::operator delete(p, align);
+}
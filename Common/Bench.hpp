@@ -0,0 +1,121 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+// tiny helpers shared by the benchmarks in this repo, header only.
+// g++ xxx.cpp -std=c++20 -O2 -pthread -I.
+namespace bench
+{
+
+using Clock = std::chrono::steady_clock;
+
+inline std::uint64_t nowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+}
+
+// keep the optimizer from deleting the value(or the loop that computes it)
+template <class T>
+inline void doNotOptimize(T const& value)
+{
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+inline void clobberMemory()
+{
+    asm volatile("" : : : "memory");
+}
+
+inline void cpuRelax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+// best effort, a failure(e.g. only one core) just leaves the thread unpinned
+inline bool pinThread(int cpu)
+{
+#if defined(__linux__)
+    auto n = std::thread::hardware_concurrency();
+    if(n == 0)
+        return false;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu % n, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    (void)cpu;
+    return false;
+#endif
+}
+
+// samples must be sorted, p in [0, 1]
+template <class T>
+T percentile(const std::vector<T>& sorted, double p)
+{
+    if(sorted.empty())
+        return T{};
+    auto idx = static_cast<std::size_t>(p * static_cast<double>(sorted.size() - 1) + 0.5);
+    return sorted[std::min(idx, sorted.size() - 1)];
+}
+
+template <class T>
+T median(std::vector<T> samples)
+{
+    std::sort(samples.begin(), samples.end());
+    return percentile(samples, 0.5);
+}
+
+// run fn() `repeat` times, return the median wall time in nanoseconds
+template <class F>
+double measureNs(int repeat, F&& fn)
+{
+    std::vector<double> samples;
+    samples.reserve(repeat);
+    for(int i = 0; i < repeat; ++i)
+    {
+        auto start = Clock::now();
+        fn();
+        auto end = Clock::now();
+        samples.push_back(std::chrono::duration<double, std::nano>(end - start).count());
+    }
+    return median(std::move(samples));
+}
+
+// same as above, but setup() runs before every repetition and is not timed
+template <class Setup, class F>
+double measureNs(int repeat, Setup&& setup, F&& fn)
+{
+    std::vector<double> samples;
+    samples.reserve(repeat);
+    for(int i = 0; i < repeat; ++i)
+    {
+        setup();
+        auto start = Clock::now();
+        fn();
+        auto end = Clock::now();
+        samples.push_back(std::chrono::duration<double, std::nano>(end - start).count());
+    }
+    return median(std::move(samples));
+}
+
+inline void printRow(const std::string& name, double value, const char* unit)
+{
+    std::printf("%-40s %14.2f %s\n", name.c_str(), value, unit);
+}
+
+} // namespace bench
@@ -0,0 +1,208 @@
+#pragma once
+
+/*
+ * clocks that don't cost a syscall per read, header only, linux. all of them are std::chrono clocks with the
+ * epoch of steady_clock(CLOCK_MONOTONIC), so their time points can be compared through time_since_epoch().
+ *
+ *     auto start = clocks::TscClock::now();
+ *     ...
+ *     auto elapsed = clocks::TscClock::now() - start;      // std::chrono::nanoseconds
+ *
+ * + CoarseClock:     CLOCK_MONOTONIC_COARSE, the time of the last timer tick(1..4ms, see resolution()), read
+ *                    from the vDSO without entering the kernel
+ * + TickerClock<Us>: a background thread stores steady_clock::now() every Us microseconds, now() is one relaxed
+ *                    load. the thread starts on the first now() and is never stopped
+ * + TscClock:        rdtsc scaled to ns, calibrated against steady_clock once(~20ms, on the first now() or by
+ *                    calibrate()). needs an invariant TSC that is synchronized between cores: true on current
+ *                    x86 hardware, check invariantTsc() on old cpus and multi socket boards. it drifts from
+ *                    steady_clock by the calibration error(a few ppm), it doesn't follow NTP adjustments
+ *
+ * steady_clock::now() itself goes through the vDSO too, unless the kernel's clocksource can't be read from user
+ * space(some VMs: xen, hyperv without tsc page, ...), then every read is a real syscall.
+ * see "Tweaks/6. Zero Syscall.md" and Common/ClockBench.cpp for the cost per read and the drift.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <thread>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <x86intrin.h>
+#endif
+
+namespace clocks
+{
+
+inline std::int64_t steadyNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// the cpu's time stamp counter(cntvct on arm64), steady_clock ns elsewhere
+inline std::uint64_t rdtsc()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#elif defined(__aarch64__)
+    std::uint64_t value;
+    asm volatile("mrs %0, cntvct_el0" : "=r"(value));
+    return value;
+#else
+    return static_cast<std::uint64_t>(steadyNs());
+#endif
+}
+
+// the TSC ticks at a constant rate in every P/C state(cpuid 0x80000007, edx bit 8). VMs often hide the bit
+inline bool invariantTsc()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    unsigned eax, ebx, ecx, edx;
+    if(__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) == 0)
+        return false;
+    return (edx & (1u << 8)) != 0;
+#elif defined(__aarch64__)
+    return true;
+#else
+    return false;
+#endif
+}
+
+
+struct CoarseClock
+{
+    using rep = std::int64_t;
+    using period = std::nano;
+    using duration = std::chrono::nanoseconds;
+    using time_point = std::chrono::time_point<CoarseClock>;
+    static constexpr bool is_steady = true;
+
+    static time_point now() noexcept
+    {
+        timespec ts;
+        ::clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+        return time_point(duration(static_cast<rep>(ts.tv_sec) * 1000000000 + ts.tv_nsec));
+    }
+    static duration resolution() noexcept
+    {
+        timespec ts;
+        ::clock_getres(CLOCK_MONOTONIC_COARSE, &ts);
+        return duration(static_cast<rep>(ts.tv_sec) * 1000000000 + ts.tv_nsec);
+    }
+};
+
+
+template <unsigned IntervalUs = 1000>
+struct TickerClock
+{
+    using rep = std::int64_t;
+    using period = std::nano;
+    using duration = std::chrono::nanoseconds;
+    using time_point = std::chrono::time_point<TickerClock>;
+    static constexpr bool is_steady = true;
+
+    static time_point now() noexcept { return time_point(duration(ticker().value.load(std::memory_order_relaxed))); }
+    static constexpr duration resolution() noexcept { return std::chrono::microseconds(IntervalUs); }
+private:
+    struct alignas(64) Ticker
+    {
+        std::atomic<rep> value{steadyNs()};     // only the ticker writes the line, readers share it
+    };
+    static Ticker& ticker()
+    {
+        // leaked: the detached thread keeps writing it until the process exits
+        static Ticker& instance = *start(new Ticker);
+        return instance;
+    }
+    static Ticker* start(Ticker* ticker)
+    {
+        std::thread([ticker]() {
+            for(;;)
+            {
+                std::this_thread::sleep_for(std::chrono::microseconds(IntervalUs));
+                ticker->value.store(steadyNs(), std::memory_order_relaxed);
+            }
+        }).detach();
+        return ticker;
+    }
+};
+
+
+struct TscClock
+{
+    using rep = std::int64_t;
+    using period = std::nano;
+    using duration = std::chrono::nanoseconds;
+    using time_point = std::chrono::time_point<TscClock>;
+    static constexpr bool is_steady = true;
+
+    // ns = ns0 + (tsc - tsc0) * mult / 2^32
+    struct Calibration
+    {
+        std::uint64_t tsc0;
+        std::int64_t ns0;
+        std::uint64_t mult;
+        double ticksPerNs;
+    };
+
+    static time_point now() noexcept
+    {
+        auto& c = calibration();
+        auto ticks = static_cast<std::int64_t>(rdtsc() - c.tsc0);      // negative on a core slightly behind
+        auto ns = ticks >= 0 ? static_cast<std::int64_t>((static_cast<unsigned __int128>(ticks) * c.mult) >> 32)
+                             : -static_cast<std::int64_t>((static_cast<unsigned __int128>(-ticks) * c.mult) >> 32);
+        return time_point(duration(c.ns0 + ns));
+    }
+    // pay the calibration up front instead of in the first now()
+    static const Calibration& calibrate() { return calibration(); }
+private:
+    static const Calibration& calibration()
+    {
+        static const Calibration c = measure(std::chrono::milliseconds(20));
+        return c;
+    }
+    // a steady_clock reading and the tsc at the same moment: the middle of the tightest of a few brackets
+    static void pair(std::uint64_t& tsc, std::int64_t& ns)
+    {
+        std::uint64_t best = ~std::uint64_t(0);
+        for(int i = 0; i < 8; ++i)
+        {
+            auto before = rdtsc();
+            auto now = steadyNs();
+            auto after = rdtsc();
+            if(after - before < best)
+            {
+                best = after - before;
+                tsc = before + (after - before) / 2;
+                ns = now;
+            }
+        }
+    }
+    static Calibration measure(std::chrono::nanoseconds window)
+    {
+        std::uint64_t tscA = 0, tscB = 0;
+        std::int64_t nsA = 0, nsB = 0;
+        pair(tscA, nsA);
+        std::this_thread::sleep_for(window);
+        pair(tscB, nsB);
+        auto ticks = tscB - tscA;
+        auto ns = static_cast<std::uint64_t>(nsB - nsA);
+        Calibration c;
+        c.tsc0 = tscB;
+        c.ns0 = nsB;
+        c.mult = ticks == 0 ? std::uint64_t(1) << 32 : static_cast<std::uint64_t>((static_cast<unsigned __int128>(ns) << 32) / ticks);
+        c.ticksPerNs = static_cast<double>(ticks) / static_cast<double>(ns);
+        return c;
+    }
+};
+
+// time since the clock's epoch in ns, e.g. clocks::nowNs<clocks::TscClock>()
+template <class Clock>
+inline std::int64_t nowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+}
+
+} // namespace clocks
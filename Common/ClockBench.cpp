@@ -0,0 +1,114 @@
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <functional>
+#include <thread>
+#include <vector>
+
+#include "Clock.hpp"
+#include "Bench.hpp"
+
+/*
+ * the clocks of Clock.hpp against the standard ones.
+ * + ns per read: a loop of reads, single thread
+ * + step: the smallest change between two reads(the resolution seen by a caller), median of a few
+ * + drift: every 250ms each clock minus steady_clock, read back to back. the coarse clocks lag by up to their
+ *   step, the TSC clock wanders by its calibration error
+ *
+ * g++ ClockBench.cpp -std=c++20 -O2 -pthread
+ * ./a.out [reads = 4M] [drift seconds = 3]
+ */
+
+struct Source
+{
+    const char* name;
+    std::function<std::int64_t()> read;         // ns, steady_clock epoch where it has one
+};
+
+// std::function would be measured too: the loop is instantiated per clock
+template <class F>
+double nsPerRead(std::size_t reads, F read)
+{
+    auto ns = bench::measureNs(3, [&]() {
+        std::uint64_t sum = 0;
+        for(std::size_t i = 0; i < reads; ++i)
+            sum += static_cast<std::uint64_t>(read());
+        bench::doNotOptimize(sum);
+    });
+    return ns / static_cast<double>(reads);
+}
+
+double stepNs(const std::function<std::int64_t()>& read)
+{
+    std::vector<double> steps;
+    for(int i = 0; i < 9; ++i)
+    {
+        auto first = read(), next = first;
+        while((next = read()) == first)
+            ;
+        steps.push_back(static_cast<double>(next - first));
+    }
+    return bench::median(steps);
+}
+
+int main(int argc, char** argv)
+{
+    std::size_t reads = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 4 * 1024 * 1024;
+    int seconds = argc > 2 ? std::atoi(argv[2]) : 3;
+
+    // start the ticker and calibrate before anything is measured
+    clocks::TscClock::calibrate();
+    clocks::TickerClock<>::now();
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+
+    auto monotonic = []() {
+        timespec ts;
+        ::clock_gettime(CLOCK_MONOTONIC, &ts);
+        return static_cast<std::int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+    };
+    std::vector<Source> sources = {
+        {"system_clock::now", []() { return clocks::nowNs<std::chrono::system_clock>(); }},
+        {"steady_clock::now", []() { return clocks::nowNs<std::chrono::steady_clock>(); }},
+        {"clock_gettime(MONOTONIC)", monotonic},
+        {"CoarseClock", []() { return clocks::nowNs<clocks::CoarseClock>(); }},
+        {"TickerClock<1000us>", []() { return clocks::nowNs<clocks::TickerClock<>>(); }},
+        {"TscClock", []() { return clocks::nowNs<clocks::TscClock>(); }},
+    };
+    double perRead[] = {
+        nsPerRead(reads, []() { return clocks::nowNs<std::chrono::system_clock>(); }),
+        nsPerRead(reads, []() { return clocks::nowNs<std::chrono::steady_clock>(); }),
+        nsPerRead(reads, monotonic),
+        nsPerRead(reads, []() { return clocks::nowNs<clocks::CoarseClock>(); }),
+        nsPerRead(reads, []() { return clocks::nowNs<clocks::TickerClock<>>(); }),
+        nsPerRead(reads, []() { return clocks::nowNs<clocks::TscClock>(); }),
+    };
+
+    std::printf("tsc: %.4f ticks/ns, invariant %s, CLOCK_MONOTONIC_COARSE resolution %lld ns\n\n",
+                clocks::TscClock::calibrate().ticksPerNs, clocks::invariantTsc() ? "yes" : "not reported",
+                static_cast<long long>(clocks::CoarseClock::resolution().count()));
+    std::printf("%-26s %12s %12s\n", "clock", "ns/read", "step(ns)");
+    for(std::size_t i = 0; i < sources.size(); ++i)
+        std::printf("%-26s %12.2f %12.0f\n", sources[i].name, perRead[i], stepNs(sources[i].read));
+    std::printf("%-26s %12.2f\n", "rdtsc(raw ticks)", nsPerRead(reads, []() { return static_cast<std::int64_t>(clocks::rdtsc()); }));
+
+    std::printf("\n%-8s", "drift(us)");
+    for(std::size_t i = 3; i < sources.size(); ++i)
+        std::printf(" %20s", sources[i].name);
+    std::printf("\n");
+    for(int tick = 0; tick <= seconds * 4; ++tick)
+    {
+        if(tick > 0)
+            std::this_thread::sleep_for(std::chrono::milliseconds(250));
+        std::printf("%7.2fs ", tick / 4.0);
+        for(std::size_t i = 3; i < sources.size(); ++i)
+        {
+            auto steady = clocks::steadyNs();
+            auto value = sources[i].read();
+            std::printf(" %20.1f", static_cast<double>(value - steady) / 1e3);
+        }
+        std::printf("\n");
+    }
+    return 0;
+}
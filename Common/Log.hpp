@@ -0,0 +1,303 @@
+#pragma once
+
+/*
+ * buffered, non-blocking line logging shared by the examples in this repo, header only.
+ *
+ *     NOTE_LOG("PicturePath: ", picPath, " size ", 42);    // one line, '\n' appended
+ *     logging::flush();                                    // before mixing with std::cout/printf
+ *
+ * + every thread appends whole lines into its own byte ring, no lock and no syscall on the hot path
+ * + a background flusher gathers the pending bytes of all rings and hands them to one writev()
+ * + a full ring is drained by the writer itself(never dropped, never spins on the flusher)
+ * + -DNOTE_LOG_DISABLED removes logging at compile time: NOTE_LOG expands to nothing, its arguments
+ *   are not evaluated and no thread is started
+ *
+ * lines of one thread keep their order, lines of different threads interleave line by line.
+ * g++ xxx.cpp -std=c++20 -O2 -pthread
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include <cerrno>
+#include <climits>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace logging
+{
+
+namespace detail
+{
+
+// single producer(the owning thread) single consumer(whoever holds Sink::lock) byte ring
+struct Ring
+{
+    static constexpr std::size_t capacity = 64 * 1024;      // power of two
+    static constexpr std::size_t mask = capacity - 1;
+
+    alignas(64) std::atomic<std::size_t> head{0};           // consumer
+    alignas(64) std::atomic<std::size_t> tail{0};           // producer
+    std::atomic<bool> retired{false};                       // the owning thread exited
+    char data[capacity];
+
+    std::size_t freeSpace() const
+    {
+        return capacity - (tail.load(std::memory_order_relaxed) - head.load(std::memory_order_acquire));
+    }
+    // the producer copies one line and publishes it at once
+    void append(const std::string_view* pieces, std::size_t count, std::size_t length)
+    {
+        auto pos = tail.load(std::memory_order_relaxed);
+        auto offset = pos & mask;
+        if(offset + length <= capacity)
+        {
+            for(std::size_t i = 0; i < count; ++i)
+            {
+                std::memcpy(data + offset, pieces[i].data(), pieces[i].size());
+                offset += pieces[i].size();
+            }
+        }
+        else
+        {
+            // the line wraps around the end of the ring
+            for(std::size_t i = 0; i < count; ++i)
+                for(auto c : pieces[i])
+                    data[offset++ & mask] = c;
+        }
+        tail.store(pos + length, std::memory_order_release);
+    }
+};
+
+// each argument becomes a piece of text, numbers are formatted into the scratch buffer
+struct Scratch
+{
+    char buf[32];
+};
+
+inline std::string_view toText(std::string_view value, Scratch&) { return value; }
+inline std::string_view toText(const char* value, Scratch&) { return value; }
+inline std::string_view toText(const std::string& value, Scratch&) { return value; }
+inline std::string_view toText(char value, Scratch& scratch)
+{
+    scratch.buf[0] = value;
+    return {scratch.buf, 1};
+}
+inline std::string_view toText(bool value, Scratch&) { return value ? "true" : "false"; }
+template <class T>
+    requires std::is_arithmetic_v<T>
+std::string_view toText(T value, Scratch& scratch)
+{
+    auto result = std::to_chars(scratch.buf, scratch.buf + sizeof(scratch.buf), value);
+    return {scratch.buf, static_cast<std::size_t>(result.ptr - scratch.buf)};
+}
+
+// never called: NOTE_LOG_DISABLED names the arguments in an unevaluated sizeof, so they count as used
+template <class... Args>
+int discard(const Args&...);
+
+} // namespace detail
+
+
+class Sink
+{
+public:
+    static Sink& instance()
+    {
+        static Sink sink;
+        return sink;
+    }
+    Sink(const Sink&) = delete;
+    Sink& operator=(const Sink&) = delete;
+    ~Sink()
+    {
+        {
+            std::lock_guard<std::mutex> lk(lock);
+            stopping = true;
+        }
+        wake.notify_one();
+        flusher.join();
+        drain();
+    }
+
+    // where the lines go, STDOUT_FILENO by default
+    void setOutput(int _fd)
+    {
+        drain();
+        fd.store(_fd, std::memory_order_relaxed);
+    }
+
+    template <class... Args>
+    void write(const Args&... args)
+    {
+        detail::Scratch scratch[sizeof...(Args) + 1];
+        std::string_view pieces[sizeof...(Args) + 1];
+        std::size_t i = 0;
+        ((pieces[i] = detail::toText(args, scratch[i]), ++i), ...);
+        pieces[i] = "\n";
+        std::size_t length = 0;
+        for(auto& piece : pieces)
+            length += piece.size();
+
+        auto& ring = local();
+        if(length > detail::Ring::capacity)
+        {
+            // longer than the whole ring: keep the beginning, always end the line
+            truncate(pieces, sizeof...(Args), detail::Ring::capacity - 1);
+            length = detail::Ring::capacity;
+        }
+        if(ring.freeSpace() < length)
+            drain();
+        ring.append(pieces, sizeof...(Args) + 1, length);
+        // past half full: wake the flusher early, once per drain
+        if(ring.freeSpace() < detail::Ring::capacity / 2 && !signalled.load(std::memory_order_relaxed) &&
+           !signalled.exchange(true, std::memory_order_relaxed))
+            wake.notify_one();
+    }
+
+    // write out everything logged so far(by any thread), returns when it is in the kernel
+    void drain()
+    {
+        std::lock_guard<std::mutex> lk(lock);
+        drainLocked();
+    }
+
+    std::size_t writevCalls() const { return calls.load(std::memory_order_relaxed); }
+private:
+    Sink() : flusher([this]() { run(); }) {}
+
+    // a thread's ring lives until the thread exited and the ring was drained
+    struct Owner
+    {
+        explicit Owner(Sink& sink) : ring(new detail::Ring())
+        {
+            std::lock_guard<std::mutex> lk(sink.lock);
+            sink.rings.push_back(ring);
+        }
+        ~Owner() { ring->retired.store(true, std::memory_order_release); }
+        detail::Ring* ring;
+    };
+    detail::Ring& local()
+    {
+        thread_local Owner owner(*this);
+        return *owner.ring;
+    }
+
+    static void truncate(std::string_view* pieces, std::size_t count, std::size_t limit)
+    {
+        for(std::size_t i = 0; i < count; ++i)
+        {
+            pieces[i] = pieces[i].substr(0, limit);
+            limit -= pieces[i].size();
+        }
+    }
+
+    void run()
+    {
+        std::unique_lock<std::mutex> lk(lock);
+        while(!stopping)
+        {
+            wake.wait_for(lk, std::chrono::milliseconds(10));
+            drainLocked();
+        }
+    }
+
+    // gather up to two iovecs per ring(the ring may wrap), one writev for many threads
+    void drainLocked()
+    {
+        pending.clear();
+        iov.clear();
+        for(auto* ring : rings)
+        {
+            auto head = ring->head.load(std::memory_order_relaxed);
+            auto tail = ring->tail.load(std::memory_order_acquire);
+            if(head == tail)
+                continue;
+            auto offset = head & detail::Ring::mask;
+            auto first = std::min(tail - head, detail::Ring::capacity - offset);
+            iov.push_back({ring->data + offset, first});
+            if(tail - head > first)
+                iov.push_back({ring->data, tail - head - first});
+            pending.push_back({ring, head, tail - head});
+        }
+
+        for(std::size_t next = 0; next < iov.size();)
+        {
+            auto count = static_cast<int>(std::min<std::size_t>(iov.size() - next, IOV_MAX));
+            auto written = ::writev(fd.load(std::memory_order_relaxed), iov.data() + next, count);
+            calls.fetch_add(1, std::memory_order_relaxed);
+            if(written < 0 && errno == EINTR)
+                continue;
+            if(written < 0)
+                break;      // nowhere to write, the bytes are dropped below
+            auto left = static_cast<std::size_t>(written);
+            while(next < iov.size() && left >= iov[next].iov_len)
+            {
+                left -= iov[next].iov_len;
+                ++next;
+            }
+            if(left != 0)
+            {
+                iov[next].iov_base = static_cast<char*>(iov[next].iov_base) + left;
+                iov[next].iov_len -= left;
+            }
+        }
+
+        for(auto& p : pending)
+            p.ring->head.store(p.head + p.bytes, std::memory_order_release);
+        signalled.store(false, std::memory_order_relaxed);
+        // forget the rings of exited threads once they are empty
+        std::erase_if(rings, [](detail::Ring* ring) {
+            if(!ring->retired.load(std::memory_order_acquire) ||
+               ring->head.load(std::memory_order_relaxed) != ring->tail.load(std::memory_order_acquire))
+                return false;
+            delete ring;
+            return true;
+        });
+    }
+
+    struct Pending
+    {
+        detail::Ring* ring;
+        std::size_t head;
+        std::size_t bytes;
+    };
+
+    std::mutex lock;                    // guards rings, pending, iov, stopping and every ring's head
+    std::condition_variable wake;
+    std::vector<detail::Ring*> rings;
+    std::vector<Pending> pending;       // scratch of drainLocked(), kept to reuse the memory
+    std::vector<iovec> iov;
+    std::atomic<int> fd{STDOUT_FILENO};
+    std::atomic<std::size_t> calls{0};
+    std::atomic<bool> signalled{false};
+    bool stopping = false;
+    std::thread flusher;                // last: starts after everything above is constructed
+};
+
+inline void flush()
+{
+#if !defined(NOTE_LOG_DISABLED)
+    Sink::instance().drain();
+#endif
+}
+
+} // namespace logging
+
+#if defined(NOTE_LOG_DISABLED)
+#define NOTE_LOG(...) ((void)sizeof(::logging::detail::discard(__VA_ARGS__)))
+#else
+#define NOTE_LOG(...) ::logging::Sink::instance().write(__VA_ARGS__)
+#endif
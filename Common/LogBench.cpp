@@ -0,0 +1,82 @@
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "Log.hpp"
+#include "Bench.hpp"
+
+/*
+ * cost per log line, everything goes to /dev/null so only our side of the syscall boundary is measured.
+ * + ofstream << std::endl: the usual example code, a flush(= one write syscall) per line
+ * + write() per line: the same from several threads, without the stream machinery
+ * + NOTE_LOG: per thread ring, background writev; the time includes the final flush
+ *
+ * g++ LogBench.cpp -std=c++20 -O2 -pthread
+ * ./a.out [lines per thread = 1M]
+ */
+
+template <class F>
+double perLine(int threads, std::size_t lines, F&& body)
+{
+    auto ns = bench::measureNs(3, [&]() {
+        std::vector<std::thread> workers;
+        for(int t = 0; t < threads; ++t)
+            workers.emplace_back([&, t]() { body(t, lines); });
+        for(auto& w : workers)
+            w.join();
+        logging::flush();
+    });
+    return ns / (static_cast<double>(lines) * threads);
+}
+
+int main(int argc, char** argv)
+{
+    std::size_t lines = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+    int devnull = ::open("/dev/null", O_WRONLY);
+    if(devnull < 0)
+        return 1;
+    logging::Sink::instance().setOutput(devnull);
+
+    std::printf("%-28s %8s %12s\n", "", "threads", "ns/line");
+    {
+        std::ofstream out("/dev/null");
+        auto ns = perLine(1, lines, [&](int, std::size_t n) {
+            for(std::size_t i = 0; i < n; ++i)
+                out<<"function step"<<i<<" of "<<n<<std::endl;
+        });
+        std::printf("%-28s %8d %12.1f\n", "ofstream << std::endl", 1, ns);
+    }
+    for(int threads : {1, 4})
+    {
+        auto ns = perLine(threads, lines, [&](int, std::size_t n) {
+            char buf[64];
+            for(std::size_t i = 0; i < n; ++i)
+            {
+                auto len = std::snprintf(buf, sizeof(buf), "function step%zu of %zu\n", i, n);
+                if(::write(devnull, buf, len) < 0)
+                    std::abort();
+            }
+        });
+        std::printf("%-28s %8d %12.1f\n", "write() per line", threads, ns);
+    }
+    for(int threads : {1, 4})
+    {
+        auto before = logging::Sink::instance().writevCalls();
+        auto ns = perLine(threads, lines, [&](int, std::size_t n) {
+            for(std::size_t i = 0; i < n; ++i)
+                NOTE_LOG("function step", i, " of ", n);
+        });
+        auto calls = logging::Sink::instance().writevCalls() - before;
+        std::printf("%-28s %8d %12.1f   %.0f lines per writev\n", "NOTE_LOG", threads, ns,
+                    3.0 * lines * threads / static_cast<double>(calls == 0 ? 1 : calls));
+    }
+    logging::Sink::instance().setOutput(STDOUT_FILENO);
+    ::close(devnull);
+    return 0;
+}
@@ -0,0 +1,362 @@
+#pragma once
+
+/*
+ * hardware counters around a region of code, header only, linux.
+ *
+ *     perf::Report report;
+ *     {
+ *         perf::PerfScope scope(report, "sort shuffled");
+ *         std::sort(vec.begin(), vec.end());
+ *     }                                       // the counters of the scope are added to report
+ *     report.print();
+ *     report.writeJson("sort.json");
+ *
+ * + cycles, instructions, branch misses, cache misses through perf_event_open, user space only(allowed up to
+ *   perf_event_paranoid = 2), one fd per event per thread, opened once
+ * + context switches(voluntary + involuntary) from getrusage(RUSAGE_THREAD): they happen in the kernel, which
+ *   the user space only counters don't see
+ * + no PMU(most VMs and containers) or no permission: cycles fall back to rdtsc(reference cycles, "tsc" in
+ *   the output), the other hardware counters are unavailable(null in the JSON)
+ * + counters are per thread: a scope counts the thread that created it. A scope whose work also runs on other
+ *   threads(a thread pool, parallel algorithms) passes otherThreads = true, print() and the JSON then mark its
+ *   counters as the calling thread's only; the wall time still covers all of the work
+ * + scopes with the same name are summed, print() shows the average per run
+ * + perf::measureNs(name, repeat, ...): bench::measureNs with a scope around every repetition, recorded into
+ *   Report::global(), which is written as JSON at exit when the environment has PERF_JSON=<file>
+ *
+ * a scope costs a few reads(syscalls) at both ends, a few microseconds: don't wrap anything much shorter.
+ */
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <linux/perf_event.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "Bench.hpp"
+#include "Clock.hpp"
+
+namespace perf
+{
+
+enum Event { Cycles, Instructions, BranchMisses, CacheMisses, ContextSwitches, eventCount };
+
+inline const char* name(Event event)
+{
+    switch(event)
+    {
+    case Cycles: return "cycles";
+    case Instructions: return "instructions";
+    case BranchMisses: return "branch_misses";
+    case CacheMisses: return "cache_misses";
+    case ContextSwitches: return "context_switches";
+    default: return "?";
+    }
+}
+
+// totals over `runs` scopes of the same name
+struct Sample
+{
+    std::string name;
+    std::uint64_t runs = 0;
+    std::uint64_t wallNs = 0;
+    std::uint64_t count[eventCount] = {};
+    bool available[eventCount] = {};
+    bool tscCycles = false;             // cycles are rdtsc reference cycles, not core cycles
+    bool callingThreadOnly = false;     // the work also ran on other threads, which the counters miss
+};
+
+namespace detail
+{
+
+// the counter fds of the calling thread
+class Counters
+{
+public:
+    static Counters& local()
+    {
+        thread_local Counters counters;
+        return counters;
+    }
+    Counters(const Counters&) = delete;
+    Counters& operator=(const Counters&) = delete;
+    ~Counters()
+    {
+        for(int fd : fds)
+            if(fd >= 0)
+                ::close(fd);
+    }
+    bool available(Event event) const { return fds[event] >= 0 || event == Cycles || event == ContextSwitches; }
+    bool tscCycles() const { return fds[Cycles] < 0; }
+    void read(std::uint64_t (&values)[eventCount]) const
+    {
+        for(int e = 0; e < eventCount; ++e)
+        {
+            values[e] = 0;
+            if(fds[e] < 0)
+                continue;
+            // value, time enabled, time running: scaled up if the kernel had to multiplex the counters
+            std::uint64_t data[3] = {};
+            if(::read(fds[e], data, sizeof(data)) != static_cast<ssize_t>(sizeof(data)))
+                continue;
+            values[e] = data[2] != 0 && data[2] < data[1]
+                ? static_cast<std::uint64_t>(static_cast<double>(data[0]) * data[1] / data[2]) : data[0];
+        }
+        if(fds[Cycles] < 0)
+            values[Cycles] = clocks::rdtsc();
+        rusage usage;
+        if(::getrusage(RUSAGE_THREAD, &usage) == 0)
+            values[ContextSwitches] = static_cast<std::uint64_t>(usage.ru_nvcsw + usage.ru_nivcsw);
+    }
+private:
+    Counters()
+    {
+        fds[Cycles] = open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+        fds[Instructions] = open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+        fds[BranchMisses] = open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+        fds[CacheMisses] = open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+        fds[ContextSwitches] = -1;
+    }
+    static int open(std::uint32_t type, std::uint64_t config)
+    {
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = type;
+        attr.config = config;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        // this thread, any cpu, no group
+        return static_cast<int>(::syscall(SYS_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC));
+    }
+    int fds[eventCount];
+};
+
+inline void appendJsonString(std::string& out, const std::string& value)
+{
+    out += '"';
+    for(char c : value)
+    {
+        if(c == '"' || c == '\\')
+        {
+            out += '\\';
+            out += c;
+        }
+        else if(static_cast<unsigned char>(c) < 0x20)
+        {
+            char buf[8];
+            std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+            out += buf;
+        }
+        else
+            out += c;
+    }
+    out += '"';
+}
+
+} // namespace detail
+
+
+class Report
+{
+public:
+    Report() = default;
+    Report(const Report&) = delete;
+    Report& operator=(const Report&) = delete;
+    ~Report()
+    {
+        if(this != &global())
+            return;
+        if(auto path = std::getenv("PERF_JSON"); path != nullptr && *path != '\0' && !writeJson(path))
+            std::fprintf(stderr, "perf: can't write %s\n", path);
+    }
+    // the report of perf::measureNs and of scopes created without one
+    static Report& global()
+    {
+        static Report report;
+        return report;
+    }
+
+    void add(const Sample& sample)
+    {
+        std::lock_guard<std::mutex> lk(lock);
+        for(auto& s : entries)
+        {
+            if(s.name != sample.name)
+                continue;
+            s.runs += sample.runs;
+            s.wallNs += sample.wallNs;
+            for(int e = 0; e < eventCount; ++e)
+            {
+                s.count[e] += sample.count[e];
+                s.available[e] = s.available[e] && sample.available[e];
+            }
+            s.tscCycles = s.tscCycles || sample.tscCycles;
+            s.callingThreadOnly = s.callingThreadOnly || sample.callingThreadOnly;
+            return;
+        }
+        entries.push_back(sample);
+    }
+    // the totals recorded under name, runs == 0 if there are none
+    Sample find(const std::string& name) const
+    {
+        std::lock_guard<std::mutex> lk(lock);
+        for(auto& s : entries)
+            if(s.name == name)
+                return s;
+        return Sample{name};
+    }
+    std::vector<Sample> samples() const
+    {
+        std::lock_guard<std::mutex> lk(lock);
+        return entries;
+    }
+
+    // averages per run
+    void print(std::FILE* out = stdout) const
+    {
+        auto all = samples();
+        std::fprintf(out, "%-40s %6s %12s %14s %14s %6s %12s %12s %8s\n", "scope", "runs", "wall(us)", "cycles",
+                     "instructions", "IPC", "br-misses", "cache-miss", "ctx-sw");
+        for(auto& s : all)
+        {
+            auto runs = static_cast<double>(s.runs == 0 ? 1 : s.runs);
+            auto column = [&](Event e, int width) {
+                if(s.available[e])
+                    std::fprintf(out, " %*.0f", width, static_cast<double>(s.count[e]) / runs);
+                else
+                    std::fprintf(out, " %*s", width, "-");
+            };
+            std::fprintf(out, "%-40s %6llu %12.1f", s.name.c_str(), static_cast<unsigned long long>(s.runs),
+                         static_cast<double>(s.wallNs) / runs / 1e3);
+            column(Cycles, 14);
+            column(Instructions, 14);
+            if(s.available[Instructions] && !s.tscCycles && s.count[Cycles] != 0)
+                std::fprintf(out, " %6.2f", static_cast<double>(s.count[Instructions]) / s.count[Cycles]);
+            else
+                std::fprintf(out, " %6s", "-");
+            column(BranchMisses, 12);
+            column(CacheMisses, 12);
+            column(ContextSwitches, 8);
+            std::fprintf(out, "%s%s\n", s.tscCycles ? "   (cycles: tsc)" : "",
+                         s.callingThreadOnly ? "   (counters: calling thread only)" : "");
+        }
+    }
+
+    // totals, a consumer divides by runs
+    std::string json() const
+    {
+        auto all = samples();
+        std::string out = "{\"samples\": [";
+        for(std::size_t i = 0; i < all.size(); ++i)
+        {
+            auto& s = all[i];
+            out += i == 0 ? "\n  {\"name\": " : ",\n  {\"name\": ";
+            detail::appendJsonString(out, s.name);
+            out += ", \"runs\": " + std::to_string(s.runs) + ", \"wall_ns\": " + std::to_string(s.wallNs);
+            for(int e = 0; e < eventCount; ++e)
+            {
+                out += ", \"";
+                out += name(static_cast<Event>(e));
+                out += "\": ";
+                out += s.available[e] ? std::to_string(s.count[e]) : "null";
+            }
+            out += s.tscCycles ? ", \"cycles_source\": \"tsc\"" : ", \"cycles_source\": \"pmu\"";
+            out += s.callingThreadOnly ? ", \"calling_thread_only\": true}" : ", \"calling_thread_only\": false}";
+        }
+        out += "\n]}\n";
+        return out;
+    }
+    bool writeJson(const std::string& path) const
+    {
+        auto text = json();
+        auto file = std::fopen(path.c_str(), "w");
+        if(file == nullptr)
+            return false;
+        bool ok = std::fwrite(text.data(), 1, text.size(), file) == text.size();
+        return std::fclose(file) == 0 && ok;
+    }
+private:
+    mutable std::mutex lock;
+    std::vector<Sample> entries;
+};
+
+
+class PerfScope
+{
+public:
+    // otherThreads: the work also runs on other threads, the counters only see the calling thread's part
+    PerfScope(Report& _report, std::string _name, bool _otherThreads = false)
+        : report(_report), counters(detail::Counters::local())
+    {
+        sample.name = std::move(_name);
+        sample.callingThreadOnly = _otherThreads;
+        counters.read(start);
+        startNs = bench::nowNs();
+    }
+    explicit PerfScope(std::string _name, bool _otherThreads = false)
+        : PerfScope(Report::global(), std::move(_name), _otherThreads) {}
+    PerfScope(const PerfScope&) = delete;
+    PerfScope& operator=(const PerfScope&) = delete;
+    ~PerfScope()
+    {
+        if(!stopped)
+            stop();
+    }
+    // end the scope before the end of the block, the sample is recorded once
+    const Sample& stop()
+    {
+        auto endNs = bench::nowNs();
+        std::uint64_t end[eventCount];
+        counters.read(end);
+        sample.runs = 1;
+        sample.wallNs = endNs - startNs;
+        for(int e = 0; e < eventCount; ++e)
+        {
+            sample.available[e] = counters.available(static_cast<Event>(e));
+            sample.count[e] = end[e] - start[e];
+        }
+        sample.tscCycles = counters.tscCycles();
+        stopped = true;
+        report.add(sample);
+        return sample;
+    }
+private:
+    Report& report;
+    detail::Counters& counters;
+    Sample sample;
+    std::uint64_t start[eventCount];
+    std::uint64_t startNs = 0;
+    bool stopped = false;
+};
+
+
+// bench::measureNs, every repetition counted under `name` in Report::global()
+template <class F>
+double measureNs(const std::string& name, int repeat, F&& fn)
+{
+    return bench::measureNs(repeat, [&]() {
+        PerfScope scope(name);
+        fn();
+    });
+}
+
+template <class Setup, class F>
+double measureNs(const std::string& name, int repeat, Setup&& setup, F&& fn)
+{
+    return bench::measureNs(repeat, setup, [&]() {
+        PerfScope scope(name);
+        fn();
+    });
+}
+
+} // namespace perf
@@ -0,0 +1,320 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <thread>
+#include <utility>
+
+/*
+ * single producer single consumer bounded queues, header only.
+ * all of them share the same interface:
+ *     bool try_push(U&& v);   // false when full
+ *     bool try_pop(T& out);   // false when empty
+ *     void push(U&& v);       // spin until success
+ *     void pop(T& out);       // spin until success
+ *     void flush();           // publish buffered writes(only MCRingBuffer buffers)
+ * the capacity is rounded up to a power of two, T must be default constructible and move assignable.
+ */
+namespace spsc
+{
+
+constexpr std::size_t cacheLine = 64;
+
+namespace detail
+{
+inline void cpuRelax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+// pinned threads almost never reach the yield, it only matters when both sides share a core
+template <class Pred>
+void spinUntil(Pred&& pred)
+{
+    for(unsigned spins = 0; !pred(); ++spins)
+    {
+        if(spins < 1024)
+            cpuRelax();
+        else
+            std::this_thread::yield();
+    }
+}
+
+inline std::size_t roundUpPow2(std::size_t n)
+{
+    std::size_t r = 2;
+    while(r < n)
+        r <<= 1;
+    return r;
+}
+} // namespace detail
+
+template <class T, class Derived>
+class QueueBase
+{
+public:
+    template <class U>
+    void push(U&& v)
+    {
+        // a failed try_push never consumes v, so forwarding it again is fine
+        detail::spinUntil([&]() { return self().try_push(std::forward<U>(v)); });
+    }
+    void pop(T& out)
+    {
+        detail::spinUntil([&]() { return self().try_pop(out); });
+    }
+    void flush() {}
+private:
+    Derived& self() { return static_cast<Derived&>(*this); }
+};
+
+
+/*
+ * Lamport: the classic ring buffer, head is written by the consumer, tail by the producer.
+ * every operation reads the other side's index, so that cache line ping-pongs between the cores.
+ */
+template <class T>
+class LamportQueue : public QueueBase<T, LamportQueue<T>>
+{
+public:
+    explicit LamportQueue(std::size_t capacity)
+        : mask(detail::roundUpPow2(capacity) - 1), buffer(std::make_unique<T[]>(mask + 1)) {}
+    LamportQueue(const LamportQueue&) = delete;
+    LamportQueue& operator=(const LamportQueue&) = delete;
+
+    template <class U>
+    bool try_push(U&& v)
+    {
+        auto tail = m_tail.load(std::memory_order_relaxed);
+        if(tail - m_head.load(std::memory_order_acquire) > mask)
+            return false;
+        buffer[tail & mask] = std::forward<U>(v);
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+    bool try_pop(T& out)
+    {
+        auto head = m_head.load(std::memory_order_relaxed);
+        if(head == m_tail.load(std::memory_order_acquire))
+            return false;
+        out = std::move(buffer[head & mask]);
+        m_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+    std::size_t capacity() const { return mask + 1; }
+private:
+    const std::size_t mask;
+    std::unique_ptr<T[]> buffer;
+    alignas(cacheLine) std::atomic<std::size_t> m_head{0};
+    alignas(cacheLine) std::atomic<std::size_t> m_tail{0};
+};
+
+
+/*
+ * FastForward: no shared index at all, every slot carries its own full flag.
+ * the producer only looks at the slot it is about to write, the consumer only at the slot it reads,
+ * so the two sides touch the same cache line only when the queue is (nearly) empty or full.
+ */
+template <class T>
+class FastForwardQueue : public QueueBase<T, FastForwardQueue<T>>
+{
+public:
+    explicit FastForwardQueue(std::size_t capacity)
+        : mask(detail::roundUpPow2(capacity) - 1), slots(std::make_unique<Slot[]>(mask + 1)) {}
+    FastForwardQueue(const FastForwardQueue&) = delete;
+    FastForwardQueue& operator=(const FastForwardQueue&) = delete;
+
+    template <class U>
+    bool try_push(U&& v)
+    {
+        auto& slot = slots[m_tail & mask];
+        if(slot.full.load(std::memory_order_acquire))
+            return false;
+        slot.value = std::forward<U>(v);
+        slot.full.store(true, std::memory_order_release);
+        ++m_tail;
+        return true;
+    }
+    bool try_pop(T& out)
+    {
+        auto& slot = slots[m_head & mask];
+        if(!slot.full.load(std::memory_order_acquire))
+            return false;
+        out = std::move(slot.value);
+        slot.full.store(false, std::memory_order_release);
+        ++m_head;
+        return true;
+    }
+    std::size_t capacity() const { return mask + 1; }
+private:
+    struct Slot
+    {
+        std::atomic<bool> full{false};
+        T value{};
+    };
+    const std::size_t mask;
+    std::unique_ptr<Slot[]> slots;
+    alignas(cacheLine) std::size_t m_head = 0;     // consumer private
+    alignas(cacheLine) std::size_t m_tail = 0;     // producer private
+};
+
+
+/*
+ * MCRingBuffer: Lamport plus
+ * 1. each side caches the other side's index and only re-reads it when the cached value says empty/full
+ * 2. each side publishes its own index once per `batch` operations
+ * a full producer and an empty consumer publish immediately, so they can't starve each other,
+ * but a lone item stays invisible until the batch fills or flush() is called.
+ */
+template <class T>
+class MCRingBuffer : public QueueBase<T, MCRingBuffer<T>>
+{
+public:
+    explicit MCRingBuffer(std::size_t capacity, std::size_t _batch = 32)
+        : mask(detail::roundUpPow2(capacity) - 1),
+          batch(_batch == 0 ? 1 : (_batch > (mask + 1) / 2 ? (mask + 1) / 2 : _batch)),
+          buffer(std::make_unique<T[]>(mask + 1)) {}
+    MCRingBuffer(const MCRingBuffer&) = delete;
+    MCRingBuffer& operator=(const MCRingBuffer&) = delete;
+
+    template <class U>
+    bool try_push(U&& v)
+    {
+        if(nextWrite - localRead > mask)
+        {
+            localRead = m_read.load(std::memory_order_acquire);
+            if(nextWrite - localRead > mask)
+            {
+                flush();
+                return false;
+            }
+        }
+        buffer[nextWrite & mask] = std::forward<U>(v);
+        ++nextWrite;
+        if(++writeBatch >= batch)
+            flush();
+        return true;
+    }
+    bool try_pop(T& out)
+    {
+        if(nextRead == localWrite)
+        {
+            localWrite = m_write.load(std::memory_order_acquire);
+            if(nextRead == localWrite)
+            {
+                if(readBatch != 0)
+                {
+                    m_read.store(nextRead, std::memory_order_release);
+                    readBatch = 0;
+                }
+                return false;
+            }
+        }
+        out = std::move(buffer[nextRead & mask]);
+        ++nextRead;
+        if(++readBatch >= batch)
+        {
+            m_read.store(nextRead, std::memory_order_release);
+            readBatch = 0;
+        }
+        return true;
+    }
+    void flush()
+    {
+        m_write.store(nextWrite, std::memory_order_release);
+        writeBatch = 0;
+    }
+    std::size_t capacity() const { return mask + 1; }
+private:
+    const std::size_t mask;
+    const std::size_t batch;
+    std::unique_ptr<T[]> buffer;
+    // shared
+    alignas(cacheLine) std::atomic<std::size_t> m_read{0};
+    alignas(cacheLine) std::atomic<std::size_t> m_write{0};
+    // consumer private
+    alignas(cacheLine) std::size_t localWrite = 0;
+    std::size_t nextRead = 0;
+    std::size_t readBatch = 0;
+    // producer private
+    alignas(cacheLine) std::size_t localRead = 0;
+    std::size_t nextWrite = 0;
+    std::size_t writeBatch = 0;
+};
+
+
+/*
+ * B-Queue: FastForward style slot flags plus batching.
+ * the producer probes the slot `batch` ahead, if it is empty every slot in between is empty too,
+ * so the next `batch` pushes skip the check. the consumer does the same with backtracking:
+ * probe `batch` ahead, halve the distance until a full slot is found.
+ * items are published one by one, no flush needed.
+ */
+template <class T>
+class BQueue : public QueueBase<T, BQueue<T>>
+{
+public:
+    explicit BQueue(std::size_t capacity, std::size_t _batch = 32)
+        : mask(detail::roundUpPow2(capacity) - 1),
+          batch(_batch == 0 ? 1 : (_batch > mask + 1 ? mask + 1 : _batch)),
+          slots(std::make_unique<Slot[]>(mask + 1)) {}
+    BQueue(const BQueue&) = delete;
+    BQueue& operator=(const BQueue&) = delete;
+
+    template <class U>
+    bool try_push(U&& v)
+    {
+        if(m_tail == batchTail)
+        {
+            if(!slots[(m_tail + batch - 1) & mask].full.load(std::memory_order_acquire))
+                batchTail = m_tail + batch;
+            else if(!slots[m_tail & mask].full.load(std::memory_order_acquire))
+                batchTail = m_tail + 1;
+            else
+                return false;
+        }
+        auto& slot = slots[m_tail & mask];
+        slot.value = std::forward<U>(v);
+        slot.full.store(true, std::memory_order_release);
+        ++m_tail;
+        return true;
+    }
+    bool try_pop(T& out)
+    {
+        if(m_head == batchHead)
+        {
+            auto probe = batch;
+            while(probe != 0 && !slots[(m_head + probe - 1) & mask].full.load(std::memory_order_acquire))
+                probe >>= 1;
+            if(probe == 0)
+                return false;
+            batchHead = m_head + probe;
+        }
+        auto& slot = slots[m_head & mask];
+        out = std::move(slot.value);
+        slot.full.store(false, std::memory_order_release);
+        ++m_head;
+        return true;
+    }
+    std::size_t capacity() const { return mask + 1; }
+private:
+    struct Slot
+    {
+        std::atomic<bool> full{false};
+        T value{};
+    };
+    const std::size_t mask;
+    const std::size_t batch;
+    std::unique_ptr<Slot[]> slots;
+    alignas(cacheLine) std::size_t m_head = 0;     // consumer private
+    std::size_t batchHead = 0;
+    alignas(cacheLine) std::size_t m_tail = 0;     // producer private
+    std::size_t batchTail = 0;
+};
+
+} // namespace spsc
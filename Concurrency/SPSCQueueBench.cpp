@@ -0,0 +1,133 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "SPSCQueue.hpp"
+#include "../Common/Bench.hpp"
+
+/*
+ * throughput: the producer pushes `messages` items as fast as it can, ops/sec = messages / elapsed.
+ * latency: one item in flight, the producer stamps it with steady_clock right before push and waits
+ *          until the consumer has popped it, the consumer records (now - stamp).
+ *          MCRingBuffer is flushed after every push here, otherwise a lone item is never published.
+ *
+ * g++ SPSCQueueBench.cpp -std=c++20 -O2 -pthread
+ * ./a.out [scale]      // scale multiplies the message counts, default 1
+ */
+
+template <std::size_t N>
+struct Payload
+{
+    std::uint64_t stamp = 0;
+    std::array<char, N - sizeof(std::uint64_t)> data{};
+};
+
+template <class Queue, class T>
+double throughput(std::size_t capacity, std::size_t messages)
+{
+    Queue q(capacity);
+    std::uint64_t sum = 0;
+    std::thread consumer([&]() {
+        bench::pinThread(1);
+        T item;
+        for(std::size_t i = 0; i < messages; ++i)
+        {
+            q.pop(item);
+            sum += item.stamp;
+        }
+    });
+
+    bench::pinThread(0);
+    auto start = bench::Clock::now();
+    T item;
+    for(std::size_t i = 0; i < messages; ++i)
+    {
+        item.stamp = i;
+        q.push(item);
+    }
+    q.flush();
+    consumer.join();
+    auto end = bench::Clock::now();
+
+    if(sum != messages * (messages - 1) / 2)
+        std::abort();
+    return static_cast<double>(messages) / std::chrono::duration<double>(end - start).count();
+}
+
+template <class Queue, class T>
+std::vector<std::uint64_t> latency(std::size_t capacity, std::size_t samples)
+{
+    Queue q(capacity);
+    std::vector<std::uint64_t> result;
+    result.reserve(samples);
+    alignas(spsc::cacheLine) std::atomic<std::size_t> received{0};
+
+    std::thread consumer([&]() {
+        bench::pinThread(1);
+        T item;
+        for(std::size_t i = 0; i < samples; ++i)
+        {
+            q.pop(item);
+            result.push_back(bench::nowNs() - item.stamp);
+            received.store(i + 1, std::memory_order_release);
+        }
+    });
+
+    bench::pinThread(0);
+    T item;
+    for(std::size_t i = 0; i < samples; ++i)
+    {
+        item.stamp = bench::nowNs();
+        q.push(item);
+        q.flush();
+        spsc::detail::spinUntil([&]() { return received.load(std::memory_order_acquire) == i + 1; });
+    }
+    consumer.join();
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+template <class Queue, std::size_t PayloadSize>
+void run(const char* name, std::size_t capacity, std::size_t scale)
+{
+    using T = Payload<PayloadSize>;
+    auto ops = throughput<Queue, T>(capacity, (std::size_t{1} << 22) * scale);
+    auto lat = latency<Queue, T>(capacity, 100'000 * scale);
+    std::printf("%-14s %8zu %8zu %12.2f %10llu %10llu %10llu\n", name, PayloadSize, capacity, ops / 1e6,
+                static_cast<unsigned long long>(bench::percentile(lat, 0.50)),
+                static_cast<unsigned long long>(bench::percentile(lat, 0.99)),
+                static_cast<unsigned long long>(bench::percentile(lat, 0.999)));
+}
+
+template <std::size_t PayloadSize>
+void runAll(std::size_t capacity, std::size_t scale)
+{
+    run<spsc::LamportQueue<Payload<PayloadSize>>, PayloadSize>("Lamport", capacity, scale);
+    run<spsc::FastForwardQueue<Payload<PayloadSize>>, PayloadSize>("FastForward", capacity, scale);
+    run<spsc::MCRingBuffer<Payload<PayloadSize>>, PayloadSize>("MCRingBuffer", capacity, scale);
+    run<spsc::BQueue<Payload<PayloadSize>>, PayloadSize>("B-Queue", capacity, scale);
+}
+
+int main(int argc, char** argv)
+{
+    std::size_t scale = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1;
+    if(scale == 0)
+        scale = 1;
+    if(std::thread::hardware_concurrency() < 2)
+        std::printf("warning: less than 2 cores, producer and consumer share one core\n");
+
+    std::printf("%-14s %8s %8s %12s %10s %10s %10s\n", "queue", "payload", "capacity", "Mops/s", "p50(ns)", "p99(ns)", "p999(ns)");
+    for(std::size_t capacity : {256, 4096, 65536})
+    {
+        runAll<8>(capacity, scale);
+        runAll<64>(capacity, scale);
+        runAll<256>(capacity, scale);
+    }
+    return 0;
+}
@@ -1,7 +1,44 @@
-#include <iostream>
 #include <vector>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
 
-class Library
+#include "../Common/Bench.hpp"
+#include "../Common/Log.hpp"
+
+/*
+ * the step bodies are a policy: the classes below print, the benchmark instantiates the same classes
+ * with steps that only do a little arithmetic. step2/step4 get the customizing class's wording.
+ */
+struct LoggingSteps
+{
+    void step1() { NOTE_LOG("function step11111()..."); }
+    bool step2(const char* how)
+    {
+        NOTE_LOG("step22222 is ", how, ", and return true...");
+        return true;
+    }
+    void step3() { NOTE_LOG("function step33333()..."); }
+    void step4(const char* how) { NOTE_LOG("step44444 is ", how); }
+    void step5() { NOTE_LOG("function step55555()..."); }
+};
+
+// the skeleton, written once for every form below. with Self = BasicLibrary the steps are virtual calls,
+// with a final class or a CRTP derived class the compiler knows the step and calls(and can inline) it directly
+template <class Self>
+void runSkeleton(Self& self)
+{
+    self.step1();
+    if(self.step2())
+        self.step3();
+    for(int i = 0; i < 3; ++i)
+        self.step4();
+    self.step5();
+}
+
+template <class Steps = LoggingSteps>
+class BasicLibrary
 {
 public:
     /*
@@ -9,45 +46,138 @@ public:
      * 1. 'run' method is stable, also mean the Application's behavior skeleton is fixed.
      * 2. only step2 & step4 is variable, it must be custom.
      */
-    void run()
-    {
-        step1();
-        if(step2())
-            step3();
-        for(int i = 0; i < 3; ++i)
-            step4();
-        step5();
-    }
-    virtual ~Library() = default;
+    void run() { runSkeleton(*this); }
+    virtual ~BasicLibrary() = default;
+    Steps steps;
 protected:
     virtual bool step2() = 0;
     virtual void step4() = 0;
 private:
-    void step1() { std::cout<<"function step11111()...\n"; }
-    void step3() { std::cout<<"function step33333()...\n"; }
-    void step5() { std::cout<<"function step55555()...\n"; }
+    template <class Self>
+    friend void runSkeleton(Self& self);
+    void step1() { steps.step1(); }
+    void step3() { steps.step3(); }
+    void step5() { steps.step5(); }
 };
+using Library = BasicLibrary<>;
 
-class Application : public Library
+template <class Steps = LoggingSteps>
+class BasicApplication : public BasicLibrary<Steps>
 {
 public:
-    bool step2() override
-    {
-        std::cout<<"step22222 is override, and return true...\n";
-        return true;
-    }
+    bool step2() override { return this->steps.step2("override"); }
+    void step4() override { this->steps.step4("override"); }
+    ~BasicApplication(){}
+};
+using Application = BasicApplication<>;
 
-    void step4() override
-    {
-        std::cout<<"step44444 is override\n";
-    }
-    ~Application(){}
+
+// keeps the virtual interface(it is still a Library), but a caller holding a FinalApplication gets direct calls
+template <class Steps = LoggingSteps>
+class BasicFinalApplication final : public BasicLibrary<Steps>
+{
+public:
+    // hides BasicLibrary::run, through a Library& the virtual skeleton is used as before
+    void run() { runSkeleton(*this); }
+    bool step2() override { return this->steps.step2("override in a final class"); }
+    void step4() override { this->steps.step4("override in a final class"); }
+    ~BasicFinalApplication(){}
 };
+using FinalApplication = BasicFinalApplication<>;
 
-int main()
+
+// the same fixed skeleton resolved at compile time: no vtable, step2/step4 can be inlined into run()
+template <class Derived, class Steps = LoggingSteps>
+class StaticLibrary
+{
+public:
+    void run() { runSkeleton(static_cast<Derived&>(*this)); }
+    Steps steps;
+protected:
+    ~StaticLibrary() = default;     // never deleted through the base
+private:
+    template <class Self>
+    friend void runSkeleton(Self& self);
+    void step1() { steps.step1(); }
+    void step3() { steps.step3(); }
+    void step5() { steps.step5(); }
+};
+
+template <class Steps = LoggingSteps>
+class BasicStaticApplication : public StaticLibrary<BasicStaticApplication<Steps>, Steps>
+{
+public:
+    bool step2() { return this->steps.step2("resolved at compile time"); }
+    void step4() { this->steps.step4("resolved at compile time"); }
+    ~BasicStaticApplication(){}
+};
+using StaticApplication = BasicStaticApplication<>;
+
+
+
+// the benchmark's steps: a little arithmetic instead of printing, so that the loop measures the calls.
+// acc carries a dependency from run to run.
+struct CountingSteps
+{
+    std::uint64_t acc = 1;
+    void step1() { acc = acc * 31 + 7; }
+    bool step2(const char*) { return (acc & 3) != 0; }
+    void step3() { acc ^= acc >> 13; }
+    void step4(const char*) { acc += acc >> 3; }
+    void step5() { ++acc; }
+};
+
+// the optimizer must not see which object it gets, or it devirtualizes the first case too
+[[gnu::noipa]] BasicLibrary<CountingSteps>* opaque(BasicLibrary<CountingSteps>* lib) { return lib; }
+
+void benchmark(std::uint64_t iterations)
+{
+    BasicApplication<CountingSteps> app;
+    BasicLibrary<CountingSteps>* lib = opaque(&app);
+    auto virtualNs = bench::measureNs(3, [&]() {
+        for(std::uint64_t i = 0; i < iterations; ++i)
+            lib->run();
+        bench::doNotOptimize(lib->steps.acc);
+    });
+
+    BasicFinalApplication<CountingSteps> finalApp;
+    auto finalNs = bench::measureNs(3, [&]() {
+        for(std::uint64_t i = 0; i < iterations; ++i)
+            finalApp.run();
+        bench::doNotOptimize(finalApp.steps.acc);
+    });
+
+    BasicStaticApplication<CountingSteps> staticApp;
+    auto staticNs = bench::measureNs(3, [&]() {
+        for(std::uint64_t i = 0; i < iterations; ++i)
+            staticApp.run();
+        bench::doNotOptimize(staticApp.steps.acc);
+    });
+
+    // same skeleton, same steps, same result
+    if(app.steps.acc != finalApp.steps.acc || app.steps.acc != staticApp.steps.acc)
+        std::abort();
+    std::printf("%-36s %8.3f ns/run\n", "virtual(through Library*)", virtualNs / iterations);
+    std::printf("%-36s %8.3f ns/run\n", "final class(devirtualized)", finalNs / iterations);
+    std::printf("%-36s %8.3f ns/run\n", "CRTP StaticLibrary<Derived>", staticNs / iterations);
+}
+
+// g++ "1. Template Method.cpp" -std=c++20 -O2 -pthread
+// ./a.out bench [iterations = 10^8]
+int main(int argc, char** argv)
 {
     Application app;
     app.run();
+
+    FinalApplication finalApp;
+    finalApp.run();
+
+    StaticApplication staticApp;
+    staticApp.run();
+
+    logging::flush();
+    if(argc > 1 && std::string(argv[1]) == "bench")
+        benchmark(argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 100000000);
     return 0;
 }
 /* a example: unused Template Method pattern's code
@@ -3,16 +3,17 @@
 #include <mutex>
 #include <atomic>
 #include <thread>
+#include <vector>
+#include <latch>
+#include <cstdlib>
+#include <algorithm>
 
-class Singleton
-{
-public:
-    static Singleton* getInstance();
-    Singleton() = default;
-    Singleton(const Singleton&) = delete;
-    Singleton& operator=(const Singleton&) = delete;
-private:
-};
+#include "../Common/Bench.hpp"
+
+/*
+ * the history below(kept in comments) is about a single hand written class,
+ * the real code at the bottom is a generic Singleton<T, Policy>.
+ */
 
 /*
 // thread unsafe
@@ -121,24 +122,158 @@ Singleton Singleton::getInstance()
 }
 */
 
-static std::atomic<Singleton*> m_instance;
-Singleton* Singleton::getInstance()
+/*
+ * Singleton<T, Policy>: the policy decides how the hot path checks for the instance
+ * + MeyersPolicy:      function local static, the compiler emits a guard check(an acquire load, a plain mov on x86)
+ * + CallOncePolicy:    std::call_once, goes through the library call even after initialization
+ * + DCLPPolicy:        the acquire/release double-checked locking above, no fence on the fast path
+ * + ThreadLocalPolicy: caches the pointer in a thread_local, after the first call the hot path never
+ *                      touches shared memory(no cache line is shared between the callers)
+ */
+struct MeyersPolicy
+{
+    template <class T>
+    static T* get()
+    {
+        static T instance;
+        return &instance;
+    }
+};
+
+struct CallOncePolicy
+{
+    template <class T>
+    static T* get()
+    {
+        static std::once_flag once;
+        static T* instance = nullptr;
+        std::call_once(once, []() -> void { instance = new T(); });
+        return instance;
+    }
+};
+
+struct DCLPPolicy
+{
+    template <class T>
+    static T* get()
+    {
+        static std::mutex lock;
+        static std::atomic<T*> m_instance{nullptr};
+        auto tmp = m_instance.load(std::memory_order_acquire);
+        if(tmp == nullptr)
+        {
+            std::lock_guard<std::mutex>lk(lock);
+            tmp = m_instance.load(std::memory_order_relaxed);
+            if(tmp == nullptr)
+            {
+                tmp = new T();
+                m_instance.store(tmp, std::memory_order_release);
+            }
+        }
+        return tmp;
+    }
+};
+
+struct ThreadLocalPolicy
+{
+    template <class T>
+    static T* get()
+    {
+        thread_local T* cached = nullptr;
+        if(cached == nullptr)
+            cached = DCLPPolicy::get<T>();
+        return cached;
+    }
+};
+
+template <class T, class Policy = MeyersPolicy>
+class Singleton
+{
+public:
+    static T* getInstance() { return Policy::template get<T>(); }
+    Singleton() = delete;
+    Singleton(const Singleton&) = delete;
+    Singleton& operator=(const Singleton&) = delete;
+};
+
+// what the service looks up on every request
+class Registry
 {
-    static std::once_flag once;
-    std::call_once(once, [&]() -> void{ m_instance = new Singleton(); });
-    return m_instance;
+public:
+    Registry() = default;
+    Registry(const Registry&) = delete;
+    Registry& operator=(const Registry&) = delete;
+    int lookup(int key) const { return key + base; }
+private:
+    int base = 1;
+};
+
+
+// N threads start together and call getInstance() in a tight loop
+template <class Policy>
+double nsPerCall(unsigned threads, std::size_t iters)
+{
+    std::latch start(threads + 1);
+    std::vector<std::thread> pool;
+    std::vector<double> elapsed(threads);
+    for(unsigned t = 0; t < threads; ++t)
+    {
+        pool.emplace_back([&, t]() {
+            bench::pinThread(static_cast<int>(t));
+            start.arrive_and_wait();
+            auto begin = bench::Clock::now();
+            for(std::size_t i = 0; i < iters; ++i)
+                bench::doNotOptimize(Singleton<Registry, Policy>::getInstance());
+            auto end = bench::Clock::now();
+            elapsed[t] = std::chrono::duration<double, std::nano>(end - begin).count();
+        });
+    }
+    start.arrive_and_wait();
+    for(auto& th : pool)
+        th.join();
+    double sum = 0;
+    for(auto e : elapsed)
+        sum += e;
+    return sum / threads / static_cast<double>(iters);
 }
 
-int main()
+template <class Policy>
+void benchmark(const char* name, unsigned maxThreads, std::size_t iters)
 {
-    auto func = []() -> void {
-        auto instance = Singleton::getInstance();
-        std::cout<<instance<<std::endl;
-    };
-    for(int i = 0; i < 100; ++i)
+    // 1, 2, 4, ... and maxThreads itself when it isn't a power of two
+    for(unsigned threads = 1;; threads = std::min(threads * 2, maxThreads))
     {
-        auto t = std::thread{func};
-        t.join();
+        std::cout<<name<<"\tthreads: "<<threads<<"\t"<<nsPerCall<Policy>(threads, iters)<<" ns/call\n";
+        if(threads == maxThreads)
+            break;
     }
+}
+
+// g++ "10. Singleton.cpp" -std=c++20 -O2 -pthread
+// ./a.out [threads = hardware_concurrency] [iterations per thread = 100M]
+int main(int argc, char** argv)
+{
+    // every thread must see the same instance
+    {
+        std::vector<std::thread> pool;
+        std::vector<Registry*> seen(100);
+        for(int i = 0; i < 100; ++i)
+            pool.emplace_back([&seen, i]() { seen[i] = Singleton<Registry, DCLPPolicy>::getInstance(); });
+        for(auto& t : pool)
+            t.join();
+        for(auto p : seen)
+            if(p != seen[0])
+                return 1;
+        std::cout<<seen[0]<<std::endl;
+    }
+
+    unsigned maxThreads = argc > 1 ? static_cast<unsigned>(std::atoi(argv[1])) : std::thread::hardware_concurrency();
+    std::size_t iters = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 100'000'000;
+    if(maxThreads == 0)
+        maxThreads = 1;
+    benchmark<MeyersPolicy>("Meyers", maxThreads, iters);
+    benchmark<CallOncePolicy>("call_once", maxThreads, iters);
+    benchmark<DCLPPolicy>("DCLP", maxThreads, iters);
+    benchmark<ThreadLocalPolicy>("thread_local", maxThreads, iters);
     return 0;
 }
@@ -1,36 +1,66 @@
 #include <iostream>
 #include <memory>
 #include <vector>
+#include <variant>
+#include <span>
+#include <random>
+#include <cstdlib>
+#include <stdexcept>
+
+#include "../Common/Bench.hpp"
 
 /*
  * when calculation logic is stable, but algorithm often changes(such as parameter in here)
  */
 
+struct OrderLine
+{
+    double price;
+    double quantity;
+};
+
+// the batch overloads write out[i] for every line: out must hold at least lines.size() values
+inline void checkOutput(std::span<const OrderLine> lines, std::span<double> out)
+{
+    if(out.size() < lines.size())
+        throw std::length_error("CalculateTax: out is shorter than lines");
+}
+
+// the real computations, shared by the virtual and the static strategies so both give identical results
+namespace tax
+{
+inline double cn(const OrderLine& line) { return line.price * line.quantity * 0.13; }
+// clothing-style exemption: items under $110 are not taxed, a select rather than a branch
+inline double us(const OrderLine& line) { return line.price < 110.0 ? 0.0 : line.price * line.quantity * 0.08875; }
+inline double de(const OrderLine& line) { return line.price * line.quantity * 0.19; }
+inline double jp(const OrderLine& line) { return line.price * line.quantity * 0.10; }
+}
+
 class TaxStrategy
 {
 public:
-    virtual void calculate() = 0;
+    virtual double calculate(const OrderLine& line) const = 0;
     virtual ~TaxStrategy() = default;
 };
 
 class CNTax : public TaxStrategy
 {
 public:
-    void calculate() override { std::cout<<"tax == CN_Tax\n"; }
+    double calculate(const OrderLine& line) const override { return tax::cn(line); }
     ~CNTax() {}
 };
 
 class USTax : public TaxStrategy
 {
 public:
-    void calculate() override { std::cout<<"tax == US_Tax\n"; }
+    double calculate(const OrderLine& line) const override { return tax::us(line); }
     ~USTax() {}
 };
 
 class DETax : public TaxStrategy
 {
 public:
-    void calculate() override { std::cout<<"tax == DE_Tax\n"; }
+    double calculate(const OrderLine& line) const override { return tax::de(line); }
     ~DETax() {}
 };
 
@@ -38,7 +68,7 @@ public:
 class JPTax : public TaxStrategy
 {
 public:
-    void calculate() override { std::cout<<"tax == JP_Tax\n"; }
+    double calculate(const OrderLine& line) const override { return tax::jp(line); }
     ~JPTax() {}
 };
 
@@ -47,27 +77,155 @@ class SalesOrder
 public:
     // explicit just for easy to test...
     explicit SalesOrder(std::unique_ptr<TaxStrategy> _taxstrategy) : strategy(std::move(_taxstrategy)) {}
-    double CalculateTax()
+    double CalculateTax(const OrderLine& line) const
+    {
+        return strategy->calculate(line);
+    }
+    // one virtual call per line. out.size() >= lines.size(), otherwise std::length_error
+    void CalculateTax(std::span<const OrderLine> lines, std::span<double> out) const
     {
-        strategy->calculate();
-        return 0.0;
+        checkOutput(lines, out);
+        for(std::size_t i = 0; i < lines.size(); ++i)
+            out[i] = strategy->calculate(lines[i]);
     }
     ~SalesOrder() {}
 private:
     std::unique_ptr<TaxStrategy>strategy;
 };
 
-int main()
+
+/*
+ * static dispatch: the strategy is known at compile time(CRTP) or chosen once per batch(std::variant),
+ * no heap allocation, no virtual call, the per line loop is a plain loop the compiler can vectorize.
+ * adding a country still doesn't touch StaticSalesOrder, only the variant's type list.
+ */
+template <class Derived>
+class StaticTaxStrategy
 {
-    auto cnTaxStrategy = std::make_unique<CNTax>();
-    SalesOrder cnSalesOrder(std::move(cnTaxStrategy));
-    cnSalesOrder.CalculateTax();
+public:
+    double calculate(const OrderLine& line) const { return Derived::apply(line); }
+    // out.size() >= lines.size(), otherwise std::length_error
+    void calculate(std::span<const OrderLine> lines, std::span<double> out) const
+    {
+        checkOutput(lines, out);
+        const auto n = lines.size();
+        const OrderLine* in = lines.data();
+        double* res = out.data();
+        for(std::size_t i = 0; i < n; ++i)
+            res[i] = Derived::apply(in[i]);
+    }
+};
+
+class CNTaxStatic : public StaticTaxStrategy<CNTaxStatic>
+{
+public:
+    static double apply(const OrderLine& line) { return tax::cn(line); }
+};
 
-    auto cnTaxStrategy2 = std::make_unique<USTax>();
-    SalesOrder cnSalesOrder2(std::move(cnTaxStrategy2));
-    cnSalesOrder2.CalculateTax();
+class USTaxStatic : public StaticTaxStrategy<USTaxStatic>
+{
+public:
+    static double apply(const OrderLine& line) { return tax::us(line); }
+};
+
+class DETaxStatic : public StaticTaxStrategy<DETaxStatic>
+{
+public:
+    static double apply(const OrderLine& line) { return tax::de(line); }
+};
+
+class JPTaxStatic : public StaticTaxStrategy<JPTaxStatic>
+{
+public:
+    static double apply(const OrderLine& line) { return tax::jp(line); }
+};
+
+template <class Strategy>
+class StaticSalesOrder
+{
+public:
+    double CalculateTax(const OrderLine& line) const { return strategy.calculate(line); }
+    // out.size() >= lines.size(), otherwise std::length_error
+    void CalculateTax(std::span<const OrderLine> lines, std::span<double> out) const { strategy.calculate(lines, out); }
+private:
+    Strategy strategy;
+};
+
+// runtime choice without the heap: std::visit once per batch, then the static loop
+class VariantSalesOrder
+{
+public:
+    using Strategy = std::variant<CNTaxStatic, USTaxStatic, DETaxStatic, JPTaxStatic>;
+    explicit VariantSalesOrder(Strategy _strategy) : strategy(_strategy) {}
+    double CalculateTax(const OrderLine& line) const
+    {
+        return std::visit([&](const auto& s) { return s.calculate(line); }, strategy);
+    }
+    // out.size() >= lines.size(), otherwise std::length_error
+    void CalculateTax(std::span<const OrderLine> lines, std::span<double> out) const
+    {
+        std::visit([&](const auto& s) { s.calculate(lines, out); }, strategy);
+    }
+private:
+    Strategy strategy;
+};
+
+
+template <class Order>
+void benchmark(const char* name, const Order& order, const std::vector<OrderLine>& lines,
+               std::vector<double>& out, const std::vector<double>& expected, int repeat)
+{
+    auto ns = bench::measureNs(repeat, [&]() {
+        order.CalculateTax(lines, out);
+        bench::clobberMemory();
+    });
+    if(out != expected)
+        std::exit(1);
+    std::cout<<name<<":\t"<<ns / static_cast<double>(lines.size())<<" ns/line\n";
 }
 
+// g++ "2. Strategy.cpp" -std=c++20 -O2 -pthread
+// ./a.out [lines = 4M] [repeat = 11]
+int main(int argc, char** argv)
+{
+    SalesOrder cnSalesOrder(std::make_unique<CNTax>());
+    std::cout<<"CN tax: "<<cnSalesOrder.CalculateTax({100.0, 2.0})<<std::endl;
+
+    SalesOrder usSalesOrder(std::make_unique<USTax>());
+    std::cout<<"US tax: "<<usSalesOrder.CalculateTax({200.0, 2.0})<<std::endl;
+
+    VariantSalesOrder deSalesOrder(DETaxStatic{});
+    std::cout<<"DE tax: "<<deSalesOrder.CalculateTax({100.0, 2.0})<<std::endl;
+
+    // a batch into a too short output is rejected, not written past its end
+    {
+        OrderLine two[2] = {{100.0, 2.0}, {200.0, 1.0}};
+        double one[1];
+        try
+        {
+            deSalesOrder.CalculateTax(two, one);
+            return 1;
+        }
+        catch(const std::length_error&) {}
+    }
+
+    std::size_t n = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 4 * 1024 * 1024;
+    int repeat = argc > 2 ? std::atoi(argv[2]) : 11;
+    std::vector<OrderLine> lines(n);
+    std::mt19937_64 rng(42);
+    std::uniform_real_distribution<double> price(1.0, 500.0);
+    std::uniform_int_distribution<int> quantity(1, 20);
+    for(auto& line : lines)
+        line = {price(rng), static_cast<double>(quantity(rng))};
+
+    std::vector<double> out(n), expected(n);
+    for(std::size_t i = 0; i < n; ++i)
+        expected[i] = tax::us(lines[i]);
+    benchmark("virtual", usSalesOrder, lines, out, expected, repeat);
+    benchmark("CRTP", StaticSalesOrder<USTaxStatic>{}, lines, out, expected, repeat);
+    benchmark("variant", VariantSalesOrder(USTaxStatic{}), lines, out, expected, repeat);
+    return 0;
+}
 
 /*
  * a contrasted example
@@ -2,9 +2,17 @@
 #include <thread>
 #include <chrono>
 #include <memory>
-#include <list>
 #include <string>
 #include <fstream>
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include <cstdio>
+
+#include "../Concurrency/SPSCQueue.hpp"
+#include "../Common/Bench.hpp"
 
 class Progress
 {
@@ -55,26 +63,303 @@ public:
 
 
 
-class ALongTimeTask
+/*
+ * a flat subscriber table:
+ * + subscribers live in one contiguous array of atomic pointers, a Handle is (generation << 32 | slot index),
+ *   so unsubscribe by handle is O(1) and a stale handle(slot already reused) is detected by the generation
+ * + readers(notify, the dispatcher) never lock: they enter a read section and walk the array, skipping holes
+ * + writers serialize on a mutex, publish with atomic stores, and never free anything a reader may still see:
+ *   removed subscribers and outgrown arrays are retired and reclaimed after a grace period(RCU style)
+ */
+class SubscriberTable
 {
 public:
-    ALongTimeTask() {}
-    void addProgress(std::unique_ptr<Progress>m_progress)
+    using Handle = std::uint64_t;
+    static constexpr Handle invalidHandle = ~Handle{0};
+
+    struct Subscriber
     {
-        m_progress_list.emplace_back(std::move(m_progress));
+        Subscriber(Handle _handle, std::unique_ptr<Progress> _progress) : handle(_handle), progress(std::move(_progress)) {}
+        const Handle handle;
+        std::unique_ptr<Progress> progress;
+        std::atomic<int> latest{0};         // used by the asynchronous dispatch
+        std::atomic<bool> pending{false};
+    };
+
+    // readers hold one while they touch any Subscriber*.
+    // a subscriber may unsubscribe(itself or others) from inside a read section: the grace period would wait for
+    // the caller's own guard, so the reclaim is deferred until the thread's outermost guard is released
+    class ReadGuard
+    {
+    public:
+        explicit ReadGuard(const SubscriberTable& _table) : table(_table)
+        {
+            ++readDepth();
+            idx = table.epoch.load() & 1;
+            table.readers[idx].count.fetch_add(1);
+        }
+        ReadGuard(const ReadGuard&) = delete;
+        ReadGuard& operator=(const ReadGuard&) = delete;
+        ~ReadGuard()
+        {
+            table.readers[idx].count.fetch_sub(1);
+            if(--readDepth() == 0 && table.deferred.exchange(false))
+            {
+                std::unique_lock<std::mutex> lk(table.writeLock);
+                table.collect(lk);
+            }
+        }
+    private:
+        const SubscriberTable& table;
+        unsigned idx;
+    };
+
+    explicit SubscriberTable(std::size_t initialCapacity = 16)
+        : slots(new Slots(initialCapacity == 0 ? 1 : initialCapacity)) {}
+    SubscriberTable(const SubscriberTable&) = delete;
+    SubscriberTable& operator=(const SubscriberTable&) = delete;
+    ~SubscriberTable()
+    {
+        auto* cur = slots.load();
+        for(std::size_t i = 0; i < used.load(); ++i)
+            delete cur->entries[i].load();
+        delete cur;
+        reclaim(retiredSubscribers, retiredSlots);
     }
-    void removeProgress(std::string hashStr)
+
+    Handle subscribe(std::unique_ptr<Progress> progress)
     {
-        auto begin = m_progress_list.begin();
-        auto end   = m_progress_list.end();
-        while(begin != end)
+        std::lock_guard<std::mutex> lk(writeLock);
+        std::uint32_t index;
+        if(!freeSlots.empty())
+        {
+            index = freeSlots.back();
+            freeSlots.pop_back();
+        }
+        else
         {
-            if((*begin)->hashString == hashStr)
-                begin = m_progress_list.erase(begin);
-                //m_progress_list.erase(begin++);
-            else
-                ++begin;
+            index = static_cast<std::uint32_t>(used.load());
+            auto* cur = slots.load();
+            if(index == cur->capacity)
+                grow(cur);
+            generations.push_back(0);
         }
+        Handle handle = (static_cast<Handle>(generations[index]) << 32) | index;
+        byName.emplace(progress->hashString, handle);
+        slots.load()->entries[index].store(new Subscriber(handle, std::move(progress)));
+        if(index == used.load())
+            used.store(index + 1);
+        return handle;
+    }
+
+    bool unsubscribe(Handle handle)
+    {
+        std::unique_lock<std::mutex> lk(writeLock);
+        auto* subscriber = detach(handle);
+        if(subscriber == nullptr)
+            return false;
+        auto range = byName.equal_range(subscriber->progress->hashString);
+        for(auto it = range.first; it != range.second; ++it)
+            if(it->second == handle)
+            {
+                byName.erase(it);
+                break;
+            }
+        retire(lk, {subscriber});
+        return true;
+    }
+
+    // the old string keyed interface, now a hash lookup instead of a linear scan
+    std::size_t unsubscribe(const std::string& hashString)
+    {
+        std::unique_lock<std::mutex> lk(writeLock);
+        auto range = byName.equal_range(hashString);
+        std::vector<Subscriber*> removed;
+        for(auto it = range.first; it != range.second; ++it)
+            if(auto* subscriber = detach(it->second))
+                removed.push_back(subscriber);
+        byName.erase(range.first, range.second);
+        retire(lk, removed);
+        return removed.size();
+    }
+
+    // must be called inside a ReadGuard
+    template <class F>
+    void forEach(F&& f) const
+    {
+        auto* cur = slots.load();
+        auto n = std::min(used.load(), cur->capacity);
+        for(std::size_t i = 0; i < n; ++i)
+            if(auto* subscriber = cur->entries[i].load(std::memory_order_acquire))
+                f(*subscriber);
+    }
+
+    // must be called inside a ReadGuard, nullptr if the handle is stale
+    Subscriber* find(Handle handle) const
+    {
+        auto index = static_cast<std::uint32_t>(handle);
+        auto* cur = slots.load();
+        if(index >= std::min(used.load(), cur->capacity))
+            return nullptr;
+        auto* subscriber = cur->entries[index].load(std::memory_order_acquire);
+        return subscriber != nullptr && subscriber->handle == handle ? subscriber : nullptr;
+    }
+
+    std::size_t size() const
+    {
+        std::lock_guard<std::mutex> lk(writeLock);
+        return used.load() - freeSlots.size();
+    }
+private:
+    struct Slots
+    {
+        explicit Slots(std::size_t _capacity) : capacity(_capacity), entries(new std::atomic<Subscriber*>[_capacity]())
+        {
+            for(std::size_t i = 0; i < capacity; ++i)
+                entries[i].store(nullptr, std::memory_order_relaxed);
+        }
+        const std::size_t capacity;
+        std::unique_ptr<std::atomic<Subscriber*>[]> entries;
+    };
+    struct alignas(spsc::cacheLine) ReaderCount
+    {
+        std::atomic<long> count{0};
+    };
+    static constexpr std::size_t retireThreshold = 64;
+
+    // writeLock held
+    void grow(Slots* cur)
+    {
+        auto* bigger = new Slots(cur->capacity * 2);
+        for(std::size_t i = 0; i < cur->capacity; ++i)
+            bigger->entries[i].store(cur->entries[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+        slots.store(bigger);
+        retiredSlots.push_back(cur);
+    }
+
+    // writeLock held, unpublishes the subscriber and frees its slot for reuse
+    Subscriber* detach(Handle handle)
+    {
+        auto index = static_cast<std::uint32_t>(handle);
+        if(index >= used.load())
+            return nullptr;
+        auto& entry = slots.load()->entries[index];
+        auto* subscriber = entry.load(std::memory_order_relaxed);
+        if(subscriber == nullptr || subscriber->handle != handle)
+            return nullptr;
+        entry.store(nullptr);
+        ++generations[index];
+        freeSlots.push_back(index);
+        return subscriber;
+    }
+
+    // the read sections the calling thread is in(of any table)
+    static int& readDepth()
+    {
+        thread_local int depth = 0;
+        return depth;
+    }
+
+    // writeLock held, may be released on return
+    void retire(std::unique_lock<std::mutex>& lk, const std::vector<Subscriber*>& subscribers)
+    {
+        retiredSubscribers.insert(retiredSubscribers.end(), subscribers.begin(), subscribers.end());
+        if(retiredSubscribers.size() < retireThreshold)
+            return;
+        if(readDepth() > 0)
+        {
+            deferred.store(true);       // our own guard would never leave the grace period
+            return;
+        }
+        collect(lk);
+    }
+
+    // writeLock held, released on return
+    void collect(std::unique_lock<std::mutex>& lk) const
+    {
+        auto subscribers = std::move(retiredSubscribers);
+        auto arrays = std::move(retiredSlots);
+        retiredSubscribers.clear();
+        retiredSlots.clear();
+        lk.unlock();                // readers may take a while, don't block other writers meanwhile
+        synchronize();
+        reclaim(subscribers, arrays);
+    }
+
+    // wait until every reader that could have seen a retired pointer has left.
+    // flipping twice also covers a reader that read the epoch long ago and increments the stale counter late.
+    void synchronize() const
+    {
+        std::lock_guard<std::mutex> lk(graceLock);
+        for(int flip = 0; flip < 2; ++flip)
+        {
+            auto old = epoch.fetch_add(1) & 1;
+            spsc::detail::spinUntil([&]() { return readers[old].count.load() == 0; });
+        }
+    }
+
+    static void reclaim(std::vector<Subscriber*>& subscribers, std::vector<Slots*>& arrays)
+    {
+        for(auto* subscriber : subscribers)
+            delete subscriber;
+        for(auto* array : arrays)
+            delete array;
+        subscribers.clear();
+        arrays.clear();
+    }
+
+    std::atomic<Slots*> slots;
+    std::atomic<std::size_t> used{0};            // slots ever handed out, readers scan [0, used)
+    mutable ReaderCount readers[2];
+    mutable std::atomic<unsigned> epoch{0};
+
+    mutable std::mutex writeLock;
+    mutable std::mutex graceLock;
+    std::vector<std::uint32_t> freeSlots;
+    std::vector<std::uint32_t> generations;
+    std::unordered_multimap<std::string, Handle> byName;
+    // retired under writeLock, reclaimed by collect() from a writer or from the last guard of a reader
+    mutable std::vector<Subscriber*> retiredSubscribers;
+    mutable std::vector<Slots*> retiredSlots;
+    mutable std::atomic<bool> deferred{false};
+};
+
+
+/*
+ * Dispatch::Sync:  onProgress calls every observer on the worker thread(a slow observer blocks the task)
+ * Dispatch::Async: onProgress only records the latest value per observer and pushes the observer's handle into a
+ *                  bounded lock-free queue, a dispatcher thread drains it and calls doProgress.
+ *                  if an observer still has an undelivered update, the new value overwrites it(coalesce),
+ *                  superseded updates and updates that didn't fit into the queue are counted as dropped.
+ * add/remove may be called from any thread, also while Doing() is running.
+ */
+class ALongTimeTask
+{
+public:
+    enum class Dispatch { Sync, Async };
+    using Handle = SubscriberTable::Handle;
+
+    explicit ALongTimeTask(Dispatch _mode = Dispatch::Sync, std::size_t queueCapacity = 1024) : mode(_mode)
+    {
+        if(mode == Dispatch::Async)
+        {
+            queue = std::make_unique<spsc::FastForwardQueue<Handle>>(queueCapacity);
+            dispatcher = std::thread([this]() { dispatchLoop(); });
+        }
+    }
+    ALongTimeTask(const ALongTimeTask&) = delete;
+    ALongTimeTask& operator=(const ALongTimeTask&) = delete;
+    Handle addProgress(std::unique_ptr<Progress>m_progress)
+    {
+        return m_progress_table.subscribe(std::move(m_progress));
+    }
+    bool removeProgress(Handle handle)
+    {
+        return m_progress_table.unsubscribe(handle);
+    }
+    void removeProgress(std::string hashStr)
+    {
+        m_progress_table.unsubscribe(hashStr);
     }
     void Doing()
     {
@@ -86,20 +371,94 @@ public:
             if(i == taskSum) break;
             std::this_thread::sleep_for(3s);    // imitate some time-consume task....
         }
+        drain();
         std::cout<<std::endl;
     }
-    ~ALongTimeTask() {}
+    std::size_t droppedUpdates() const { return dropped.load(std::memory_order_relaxed); }
+    ~ALongTimeTask()
+    {
+        if(dispatcher.joinable())
+        {
+            running.store(false);
+            posted.fetch_add(1, std::memory_order_release);
+            posted.notify_one();
+            dispatcher.join();
+        }
+    }
 protected:
     void onProgress(int val)
     {
-        auto begin = m_progress_list.begin();
-        auto end   = m_progress_list.end();
-        for(; begin != end; ++begin)
-            (*begin)->doProgress(val);
+        SubscriberTable::ReadGuard guard(m_progress_table);
+        if(mode == Dispatch::Sync)
+        {
+            m_progress_table.forEach([val](SubscriberTable::Subscriber& subscriber) { subscriber.progress->doProgress(val); });
+            return;
+        }
+        m_progress_table.forEach([this, val](SubscriberTable::Subscriber& subscriber) {
+            subscriber.latest.store(val);
+            if(subscriber.pending.exchange(true))
+            {
+                // the dispatcher hasn't picked up the previous value yet, it will see this one instead
+                dropped.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            if(!queue->try_push(subscriber.handle))
+            {
+                subscriber.pending.store(false);
+                dropped.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            ++pushed;
+            posted.fetch_add(1, std::memory_order_release);
+            posted.notify_one();            // no syscall unless the dispatcher is actually waiting
+        });
     }
 private:
+    void dispatchLoop()
+    {
+        Handle handle;
+        while(true)
+        {
+            auto seen = posted.load(std::memory_order_acquire);
+            if(!queue->try_pop(handle))
+            {
+                if(!running.load())
+                    return;
+                posted.wait(seen, std::memory_order_acquire);
+                continue;
+            }
+            {
+                SubscriberTable::ReadGuard guard(m_progress_table);
+                // the observer may have been removed since, then the handle is stale
+                if(auto* subscriber = m_progress_table.find(handle))
+                {
+                    // clear pending before reading the value: a newer value stored after this point
+                    // either is read below or queues the subscriber again
+                    subscriber->pending.store(false);
+                    subscriber->progress->doProgress(subscriber->latest.load());
+                }
+            }
+            delivered.fetch_add(1, std::memory_order_release);
+        }
+    }
+
+    // wait until the dispatcher has handled everything pushed so far
+    void drain()
+    {
+        if(mode == Dispatch::Async)
+            spsc::detail::spinUntil([this]() { return delivered.load(std::memory_order_acquire) == pushed; });
+    }
+
     int taskSum = 10;       // assume have 10 tasks
-    std::list<std::unique_ptr<Progress>>m_progress_list;
+    SubscriberTable m_progress_table;
+    Dispatch mode;
+    std::unique_ptr<spsc::FastForwardQueue<Handle>> queue;
+    std::size_t pushed = 0;                   // only touched by the notifying thread
+    std::atomic<std::size_t> delivered{0};
+    std::atomic<std::size_t> dropped{0};
+    std::atomic<unsigned> posted{0};
+    std::atomic<bool> running{true};
+    std::thread dispatcher;
 };
 
 
@@ -114,17 +473,101 @@ public:
     {
         auto myProgressBar = std::make_unique<myProgress>("myProgressBar1");
         auto myProgressBar2 = std::make_unique<myProgress2>("myProgressBar2");
-        ALongTimeTask task;
+        ALongTimeTask task(ALongTimeTask::Dispatch::Async);
         task.addProgress(std::move(myProgressBar));
         task.addProgress(std::move(myProgressBar2));
         task.removeProgress("myProgressBar2");
         task.Doing();
+        std::cout<<"dropped updates: "<<task.droppedUpdates()<<std::endl;
     }
     ~MainForm() {}
 };
 
-int main()
+class CountingProgress : public Progress
+{
+public:
+    explicit CountingProgress(std::string str) : Progress(str) {}
+    void doProgress(int curProgress) override { sum += curProgress; }
+    long sum = 0;
+};
+
+class NotifyBench : public ALongTimeTask
+{
+public:
+    using ALongTimeTask::onProgress;
+};
+
+// unsubscribes itself from inside doProgress, i.e. inside the notifier's read section
+class OneShotProgress : public Progress
+{
+public:
+    OneShotProgress(ALongTimeTask& _task, int& _calls) : Progress("oneShot"), task(_task), calls(_calls) {}
+    void doProgress(int) override
+    {
+        ++calls;
+        task.removeProgress(handle);
+    }
+    ALongTimeTask& task;
+    int& calls;
+    ALongTimeTask::Handle handle = SubscriberTable::invalidHandle;
+};
+
+// more self removals than the retire threshold in one notify: the grace period must not wait for the
+// notifier's own guard(it used to hang here)
+void selfRemovalCheck()
+{
+    NotifyBench task;
+    int calls = 0;
+    for(int i = 0; i < 200; ++i)
+    {
+        auto progress = std::make_unique<OneShotProgress>(task, calls);
+        auto* raw = progress.get();
+        raw->handle = task.addProgress(std::move(progress));
+    }
+    task.onProgress(1);
+    task.onProgress(2);
+    std::printf("self removal inside notify: %d calls(expected 200)\n", calls);
+    if(calls != 200)
+        std::abort();
+}
+
+// notify fan-out, alone and while another thread keeps subscribing/unsubscribing
+void benchmark()
+{
+    selfRemovalCheck();
+    for(std::size_t subscribers : {10, 1000, 100000})
+    {
+        NotifyBench task;
+        for(std::size_t i = 0; i < subscribers; ++i)
+            task.addProgress(std::make_unique<CountingProgress>("sub" + std::to_string(i)));
+        int notifies = static_cast<int>(std::max<std::size_t>(10'000'000 / subscribers, 10));
+
+        auto idle = bench::measureNs(5, [&]() { for(int i = 0; i < notifies; ++i) task.onProgress(i); });
+
+        std::atomic<bool> stop{false};
+        std::thread churn([&]() {
+            while(!stop.load(std::memory_order_relaxed))
+                task.removeProgress(task.addProgress(std::make_unique<CountingProgress>("churn")));
+        });
+        auto busy = bench::measureNs(5, [&]() { for(int i = 0; i < notifies; ++i) task.onProgress(i); });
+        stop.store(true);
+        churn.join();
+
+        std::printf("subscribers %7zu: %12.1f ns/notify %8.2f ns/subscriber | with churn %12.1f ns/notify\n",
+                    subscribers, idle / notifies, idle / notifies / static_cast<double>(subscribers), busy / notifies);
+    }
+}
+
+// g++ "3. Observer.cpp" -std=c++20 -O2 -pthread
+// ./a.out          the progress bar demo
+// ./a.out bench    notify fan-out benchmark
+int main(int argc, char** argv)
 {
+    if(argc > 1 && std::string(argv[1]) == "bench")
+    {
+        benchmark();
+        return 0;
+    }
     MainForm app;
     app.button();
 }
@@ -1,21 +1,70 @@
 #include <iostream>
 #include <string>
+#include <string_view>
 #include <memory>
+#include <array>
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+
+#include "../Common/Bench.hpp"
+#include "../Common/AllocCount.hpp"
+
+// caller supplied storage for a description, appending never allocates.
+// length() keeps counting past the capacity so the caller can retry with a bigger buffer.
+class DescriptionBuffer
+{
+public:
+    DescriptionBuffer(char* _data, std::size_t _capacity) : data(_data), capacity(_capacity) {}
+    template <std::size_t N>
+    explicit DescriptionBuffer(char (&arr)[N]) : DescriptionBuffer(arr, N) {}
+    void append(std::string_view str)
+    {
+        if(length + str.size() <= capacity)
+            std::memcpy(data + length, str.data(), str.size());
+        else if(length < capacity)
+            std::memcpy(data + length, str.data(), capacity - length);
+        length += str.size();
+    }
+    std::string_view view() const { return {data, std::min(length, capacity)}; }
+    std::size_t size() const { return length; }
+    bool truncated() const { return length > capacity; }
+    void clear() { length = 0; }
+private:
+    char* data;
+    std::size_t capacity;
+    std::size_t length = 0;
+};
 
 // distinguish subject(Beverage) and extention(Mocha and Milk are decorated by BeverageDecorator)
 class Beverage
 {
 public:
+    // one layer of the chain on its own
+    struct Layer
+    {
+        std::string_view name;
+        double cost;
+    };
+
     virtual std::string getDescription() const = 0;
+    virtual void appendDescription(DescriptionBuffer& out) const = 0;
     virtual double cost() const = 0;
+    virtual Layer layer() const = 0;
+    virtual const Beverage* wrapped() const { return nullptr; }
     virtual ~Beverage() = default;
 };
 
 class Espresso : public Beverage
 {
 public:
+    static constexpr std::string_view name = "Espresso";
+    static constexpr double price = 1.99;
     std::string getDescription() const override { return "Espresso"; }
-    double cost() const override { return 1.99; }
+    void appendDescription(DescriptionBuffer& out) const override { out.append(name); }
+    double cost() const override { return price; }
+    Layer layer() const override { return {name, price}; }
     ~Espresso() {}
 };
 
@@ -29,6 +78,7 @@ class BeverageDecorator : public Beverage
 {
 public:
     explicit BeverageDecorator(std::unique_ptr<Beverage> _beverage) : beverage(std::move(_beverage)) {}
+    const Beverage* wrapped() const override { return beverage.get(); }
     virtual ~BeverageDecorator() = default;
 protected:
     std::unique_ptr<Beverage> beverage;
@@ -37,28 +87,228 @@ protected:
 class Mocha : public BeverageDecorator
 {
 public:
+    static constexpr std::string_view name = "Mocha";
+    static constexpr double price = 0.50;
     explicit Mocha(std::unique_ptr<Beverage> _beverage) : BeverageDecorator(std::move(_beverage)) {}
     std::string getDescription() const { return beverage->getDescription() + ", Mocha"; }
-    double cost() const override { return 0.50 + beverage->cost(); }
+    // inner description first, then our own part: each byte is written once, no temporary string
+    void appendDescription(DescriptionBuffer& out) const override
+    {
+        beverage->appendDescription(out);
+        out.append(", Mocha");
+    }
+    double cost() const override { return price + beverage->cost(); }
+    Layer layer() const override { return {name, price}; }
     ~Mocha() {}
 };
 
 class Milk : public BeverageDecorator
 {
 public:
+    static constexpr std::string_view name = "Milk";
+    static constexpr double price = 1.55;
     explicit Milk(std::unique_ptr<Beverage> _beverage) : BeverageDecorator(std::move(_beverage)) {}
     std::string getDescription() const { return beverage->getDescription() + ", Milk"; }
-    double cost() const override { return 1.55 + beverage->cost(); }
+    void appendDescription(DescriptionBuffer& out) const override
+    {
+        beverage->appendDescription(out);
+        out.append(", Milk");
+    }
+    double cost() const override { return price + beverage->cost(); }
+    Layer layer() const override { return {name, price}; }
     ~Milk() {}
 };
 
 
+/*
+ * a decorator chain copied into one contiguous object: the layers sit in an inline array(innermost first),
+ * cost() is folded once when flattening, no pointer chasing and no virtual call per layer afterwards.
+ * the layer names are string_views, they must outlive the flattened object(string literals here).
+ * a chain built on top of a FlatBeverage flattens to its layers followed by the outer ones.
+ */
+class FlatBeverage final : public Beverage
+{
+public:
+    static constexpr std::size_t maxLayers = 64;
 
+    // returns false if the chain is deeper than maxLayers(the layers of a flat innermost one included)
+    static bool flatten(const Beverage& top, FlatBeverage& out)
+    {
+        const Beverage* chain[maxLayers];
+        std::size_t depth = 0;
+        for(auto* cur = &top; cur != nullptr; cur = cur->wrapped())
+        {
+            if(depth == maxLayers)
+                return false;
+            chain[depth++] = cur;
+        }
+        // an already flat innermost beverage contributes its layers, not one "flat" layer
+        auto* inner = dynamic_cast<const FlatBeverage*>(chain[depth - 1]);
+        std::size_t innerCount = inner != nullptr ? inner->count : 0;
+        if(inner != nullptr && innerCount + depth - 1 > maxLayers)
+            return false;
+        // inner may be out itself(flattening flat, or a chain around it): its layers stay in place
+        auto innerTotal = inner != nullptr ? inner->total : 0.0;
+        if(inner != nullptr && inner != &out)
+            std::copy_n(inner->layers.begin(), innerCount, out.layers.begin());
+        out.count = innerCount;
+        out.total = innerTotal;
+        for(std::size_t i = inner != nullptr ? 1 : 0; i < depth; ++i)
+        {
+            out.layers[out.count] = chain[depth - 1 - i]->layer();
+            out.total = out.layers[out.count].cost + out.total;     // same order of additions as the chain
+            ++out.count;
+        }
+        return true;
+    }
+    std::string getDescription() const override
+    {
+        std::string str;
+        DescriptionBuffer probe(nullptr, 0);
+        appendDescription(probe);
+        str.resize(probe.size());
+        DescriptionBuffer out(str.data(), str.size());
+        appendDescription(out);
+        return str;
+    }
+    void appendDescription(DescriptionBuffer& out) const override
+    {
+        for(std::size_t i = 0; i < count; ++i)
+        {
+            if(i != 0)
+                out.append(", ");
+            out.append(layers[i].name);
+        }
+    }
+    double cost() const override { return total; }
+    Layer layer() const override { return {"Flat", total}; }
+    std::size_t depth() const { return count; }
+private:
+    std::array<Layer, maxLayers> layers{};
+    std::size_t count = 0;
+    double total = 0.0;
+};
 
 
+/*
+ * compile time composition for fixed menu items: Decorated<Espresso, Mocha, Milk>
+ * + cost() folds the prices in the same order as the runtime chain, it is a constexpr constant
+ * + the description is built into a char array at compile time
+ * + BeverageAdapter<Decorated<...>> puts it behind the runtime Beverage interface(and can be decorated further)
+ * every ingredient only needs `static constexpr std::string_view name` and `static constexpr double price`.
+ */
+template <class Base, class... Decorators>
+class Decorated
+{
+public:
+    static constexpr double cost()
+    {
+        double total = Base::price;
+        ((total = Decorators::price + total), ...);
+        return total;
+    }
+    static constexpr std::string_view getDescription() { return {description.data(), length}; }
+private:
+    static constexpr std::size_t length = Base::name.size() + (std::size_t{0} + ... + (2 + Decorators::name.size()));
+    static constexpr std::array<char, length + 1> build()
+    {
+        std::array<char, length + 1> str{};
+        std::size_t pos = 0;
+        auto append = [&](std::string_view part) {
+            for(auto c : part)
+                str[pos++] = c;
+        };
+        append(Base::name);
+        ((append(", "), append(Decorators::name)), ...);
+        return str;
+    }
+    static constexpr std::array<char, length + 1> description = build();
+};
+
+template <class Fixed>
+class BeverageAdapter final : public Beverage
+{
+public:
+    std::string getDescription() const override { return std::string(Fixed::getDescription()); }
+    void appendDescription(DescriptionBuffer& out) const override { out.append(Fixed::getDescription()); }
+    double cost() const override { return Fixed::cost(); }
+    Layer layer() const override { return {Fixed::getDescription(), Fixed::cost()}; }
+};
+
+using MochaMilkEspresso = Decorated<Espresso, Mocha, Milk>;
+static_assert(MochaMilkEspresso::cost() == Milk::price + (Mocha::price + Espresso::price));
+static_assert(MochaMilkEspresso::getDescription() == "Espresso, Mocha, Milk");
 
 
-int main()
+std::unique_ptr<Beverage> makeChain(int depth)
+{
+    std::unique_ptr<Beverage> beverage = std::make_unique<Espresso>();
+    for(int i = 0; i < depth; ++i)
+    {
+        if(i % 2 == 0)
+            beverage = std::make_unique<Mocha>(std::move(beverage));
+        else
+            beverage = std::make_unique<Milk>(std::move(beverage));
+    }
+    return beverage;
+}
+
+void benchmark()
+{
+    constexpr int iters = 100000;
+    static char storage[1024];
+    std::printf("%6s %14s %10s %14s %10s %12s %12s\n", "layers", "getDesc(ns)", "allocs", "appendDesc(ns)", "allocs", "cost(ns)", "flat(ns)");
+    for(int depth : {1, 2, 4, 8, 16, 32, 63})     // 63 decorators + Espresso = 64 layers
+    {
+        auto chain = makeChain(depth);
+        FlatBeverage flat;
+        FlatBeverage::flatten(*chain, flat);
+
+        auto before = alloccount::allocations();
+        auto concat = bench::measureNs(5, [&]() {
+            for(int i = 0; i < iters; ++i)
+                bench::doNotOptimize(chain->getDescription());
+        });
+        auto concatAllocs = static_cast<double>(alloccount::allocations() - before) / (5.0 * iters);
+
+        before = alloccount::allocations();
+        auto append = bench::measureNs(5, [&]() {
+            for(int i = 0; i < iters; ++i)
+            {
+                DescriptionBuffer out(storage);
+                chain->appendDescription(out);
+                bench::doNotOptimize(out);
+                bench::clobberMemory();
+            }
+        });
+        auto appendAllocs = static_cast<double>(alloccount::allocations() - before) / (5.0 * iters);
+
+        const Beverage* viaChain = chain.get();
+        const Beverage* viaFlat = &flat;
+        bench::doNotOptimize(viaChain);
+        bench::doNotOptimize(viaFlat);
+        auto chainCost = bench::measureNs(5, [&]() {
+            for(int i = 0; i < iters; ++i)
+                bench::doNotOptimize(viaChain->cost());
+        });
+        auto flatCost = bench::measureNs(5, [&]() {
+            for(int i = 0; i < iters; ++i)
+                bench::doNotOptimize(viaFlat->cost());
+        });
+        if(chain->cost() != flat.cost() || chain->getDescription() != flat.getDescription())
+            std::abort();
+
+        std::printf("%6d %14.1f %10.1f %14.1f %10.1f %12.2f %12.2f\n", depth + 1, concat / iters, concatAllocs,
+                    append / iters, appendAllocs, chainCost / iters, flatCost / iters);
+    }
+}
+
+
+
+
+// g++ "4. Decorator.cpp" -std=c++20 -O2
+// ./a.out bench    description/cost benchmark for chains of 1..64 layers
+int main(int argc, char** argv)
 {
     auto esp = std::make_unique<Espresso>();
     std::cout<<esp->getDescription()<<": $"<<esp->cost()<<std::endl;
@@ -68,5 +318,32 @@ int main()
 
     auto mocha_milk = std::make_unique<Milk>(std::move(mocha));
     std::cout<<mocha_milk->getDescription()<<": $"<<mocha_milk->cost()<<std::endl;
+
+    // no allocation: the description goes into a stack buffer
+    char buf[64];
+    DescriptionBuffer out(buf);
+    mocha_milk->appendDescription(out);
+    std::cout<<out.view()<<": $"<<mocha_milk->cost()<<std::endl;
+
+    FlatBeverage flat;
+    FlatBeverage::flatten(*mocha_milk, flat);
+    std::cout<<flat.getDescription()<<": $"<<flat.cost()<<std::endl;
+
+    // decorating a flat beverage and flattening again keeps the original layer names
+    auto flatMilk = std::make_unique<Milk>(std::make_unique<FlatBeverage>(flat));
+    FlatBeverage again;
+    if(!FlatBeverage::flatten(*flatMilk, again) || again.depth() != 4 || again.cost() != flatMilk->cost()
+       || again.getDescription() != "Espresso, Mocha, Milk, Milk" || again.getDescription() != flatMilk->getDescription())
+        std::abort();
+    std::cout<<again.getDescription()<<": $"<<again.cost()<<std::endl;
+
+    // known when the code is written: no chain at all, and still usable where a Beverage is expected
+    constexpr double fixedCost = MochaMilkEspresso::cost();
+    std::cout<<MochaMilkEspresso::getDescription()<<": $"<<fixedCost<<std::endl;
+    auto extraMilk = std::make_unique<Milk>(std::make_unique<BeverageAdapter<MochaMilkEspresso>>());
+    std::cout<<extraMilk->getDescription()<<": $"<<extraMilk->cost()<<std::endl;
+
+    if(argc > 1 && std::string(argv[1]) == "bench")
+        benchmark();
     return 0;
-}
\ No newline at end of file
+}
@@ -1,5 +1,15 @@
-#include <iostream>
 #include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "../Common/Log.hpp"
+#include "../Common/Bench.hpp"
+#include "../Tweaks/ZeroCopy.hpp"
 
 // different platform have different realization
 class MessageImp
@@ -14,8 +24,8 @@ public:
 class AndroidMessageImp : public MessageImp
 {
 public:
-    void drawGraph() override { std::cout<<"AndroidMessageImp::drawGraph()"<<std::endl; }
-    void playSound() override { std::cout<<"AndroidMessageImp::playSound()"<<std::endl; }
+    void drawGraph() override { NOTE_LOG("AndroidMessageImp::drawGraph()"); }
+    void playSound() override { NOTE_LOG("AndroidMessageImp::playSound()"); }
     ~AndroidMessageImp() {}
 };
 
@@ -37,30 +47,161 @@ protected:
 class MessageLite : public Message
 {
 public:
-    explicit MessageLite(std::unique_ptr<MessageImp> _messageImp) : Message(std::move(_messageImp)) {}
+    // _sink: where sendFile() transfers the file to(a socket, a pipe to a consumer...), -1 only logs the path
+    explicit MessageLite(std::unique_ptr<MessageImp> _messageImp, int _sink = -1)
+        : Message(std::move(_messageImp)), sink(_sink) {}
     void login() override
     {
         messageImp->playSound();
-        std::cout<<"login()..."<<std::endl;
+        NOTE_LOG("login()...");
     }
     void sendMessage(std::string picPath) override
     {
         messageImp->drawGraph();
-        std::cout<<"PicturePath: "<<picPath<<std::endl;
+        NOTE_LOG("PicturePath: ", picPath);
     }
+    // the file goes from the page cache to the sink inside the kernel(sendfile/splice), mmap+write as fallback
     void sendFile(std::string filePath) override
     {
         messageImp->playSound();
-        std::cout<<"FilePath: "<<filePath<<std::endl;
+        NOTE_LOG("FilePath: ", filePath);
+        if(sink < 0)
+            return;
+        int fd = ::open(filePath.c_str(), O_RDONLY | O_CLOEXEC);
+        if(fd < 0)
+        {
+            NOTE_LOG("sendFile: can't open ", filePath);
+            return;
+        }
+        auto result = zerocopy::transfer(fd, sink);
+        ::close(fd);
+        if(result.error != 0)
+            NOTE_LOG("sendFile: failed after ", result.bytes, " bytes via ", zerocopy::name(result.method), ", errno ", result.error);
+        else
+            NOTE_LOG("sendFile: ", result.bytes, " bytes via ", zerocopy::name(result.method));
+    }
+private:
+    int sink;
+};
+
+
+/*
+ * compile time bridge: a binary only ships one backend, so the implementation is a template parameter.
+ * the backend is held by value, the calls into it are direct and can be inlined, and the paths are
+ * string_views(no copy into a by-value std::string per call). any class with drawGraph()/playSound() works.
+ */
+template <class Imp>
+class StaticMessage
+{
+protected:
+    Imp messageImp;
+};
+
+template <class Imp>
+class StaticMessageLite : public StaticMessage<Imp>
+{
+public:
+    void login()
+    {
+        this->messageImp.playSound();
+        NOTE_LOG("login()...");
+    }
+    void sendMessage(std::string_view picPath)
+    {
+        this->messageImp.drawGraph();
+        NOTE_LOG("PicturePath: ", picPath);
+    }
+    void sendFile(std::string_view filePath)
+    {
+        this->messageImp.playSound();
+        NOTE_LOG("FilePath: ", filePath);
     }
 };
 
-int main()
+
+// same messages both ways, the log goes to /dev/null while measuring
+void benchmark(std::size_t messages)
+{
+    int devnull = ::open("/dev/null", O_WRONLY);
+    if(devnull < 0)
+        return;
+    logging::Sink::instance().setOutput(devnull);
+    const std::string picPath = "D:\\test\\text.jpg";      // 16 chars: one past the small string buffer
+    const std::string filePath = "D:\\test\\text.cpp";
+
+    std::unique_ptr<Message> dynamicMessage = std::make_unique<MessageLite>(std::make_unique<AndroidMessageImp>());
+    auto dynamicNs = bench::measureNs(3, [&]() {
+        for(std::size_t i = 0; i < messages; ++i)
+        {
+            dynamicMessage->sendMessage(picPath);
+            dynamicMessage->sendFile(filePath);
+        }
+        logging::flush();
+    });
+
+    StaticMessageLite<AndroidMessageImp> staticMessage;
+    auto staticNs = bench::measureNs(3, [&]() {
+        for(std::size_t i = 0; i < messages; ++i)
+        {
+            staticMessage.sendMessage(picPath);
+            staticMessage.sendFile(filePath);
+        }
+        logging::flush();
+    });
+
+    logging::Sink::instance().setOutput(STDOUT_FILENO);
+    ::close(devnull);
+    auto sends = 2.0 * messages;
+    auto print = [&](const char* name, double ns) {
+        if(ns / sends < 0.05)
+            std::printf("%-36s %8.1f ns/send   (nothing left after inlining)\n", name, ns / sends);
+        else
+            std::printf("%-36s %8.1f ns/send %8.2f M sends/s\n", name, ns / sends, sends / ns * 1e3);
+    };
+    print("Message(virtual, std::string)", dynamicNs);
+    print("StaticMessageLite<Imp>(string_view)", staticNs);
+}
+
+
+// g++ "5. Bridge.cpp" -std=c++20 -O2 -pthread
+// ./a.out bench [messages = 1M]    add -DNOTE_LOG_DISABLED to measure the bridge calls alone
+int main(int argc, char** argv)
 {
     auto messageImp = std::make_unique<AndroidMessageImp>();
     auto message = std::make_unique<MessageLite>(std::move(messageImp));
     message->login();
     message->sendFile("D:\\test\\text.cpp");
     message->sendMessage("D:\\test\\text.jpg");
+
+    // a real transfer: the running binary through a pipe to a consumer thread. /proc/self/exe rather than
+    // __FILE__(relative to the compile directory) or argv[0](not a path when found through PATH)
+    int fds[2];
+    if(::pipe(fds) == 0)
+    {
+        std::size_t received = 0;
+        std::thread consumer([&]() {
+            char buf[4096];
+            for(ssize_t n; (n = ::read(fds[0], buf, sizeof(buf))) > 0;)
+                received += static_cast<std::size_t>(n);
+        });
+        MessageLite fileMessage(std::make_unique<AndroidMessageImp>(), fds[1]);
+        fileMessage.sendFile("/proc/self/exe");
+        ::close(fds[1]);
+        consumer.join();
+        ::close(fds[0]);
+        NOTE_LOG("consumer received ", received, " bytes");
+    }
+
+    // the backend chosen at compile time
+    StaticMessageLite<AndroidMessageImp> staticMessage;
+    staticMessage.login();
+    staticMessage.sendFile("D:\\test\\text.cpp");
+    staticMessage.sendMessage("D:\\test\\text.jpg");
+
+    if(argc > 1 && std::string(argv[1]) == "bench")
+    {
+        logging::flush();
+        benchmark(argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 1000000);
+    }
     return 0;
 }
\ No newline at end of file
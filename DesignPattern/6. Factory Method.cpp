@@ -2,6 +2,23 @@
 #include <string>
 #include <memory>
 #include <vector>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <iterator>
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <string_view>
+#include <unordered_map>
+#include <optional>
+#include <cstdio>
+#include <cstdlib>
+
+#include "../Common/Bench.hpp"
+#include "../Common/AllocCount.hpp"
 
 class Editor
 {
@@ -34,19 +51,37 @@ public:
     ~PictureEditor() {}
 };
 
+// a handle that either deletes the editor or gives it back to the pool it came from
+class EditorRecycler
+{
+public:
+    EditorRecycler() = default;
+    explicit EditorRecycler(void (*_recycle)(Editor*)) : recycle(_recycle) {}
+    void operator()(Editor* editor) const
+    {
+        if(recycle)
+            recycle(editor);
+        else
+            delete editor;
+    }
+private:
+    void (*recycle)(Editor*) = nullptr;
+};
+using EditorHandle = std::unique_ptr<Editor, EditorRecycler>;
+
 class EditorFactory
 {
 public:
-    virtual std::unique_ptr<Editor> createEditor() = 0;
+    virtual EditorHandle createEditor() = 0;
     virtual ~EditorFactory() = default;
 };
 
 class TextEditorFactory : public EditorFactory
 {
 public:
-    std::unique_ptr<Editor> createEditor() override
+    EditorHandle createEditor() override
     {
-        return std::make_unique<TextEditor>();
+        return EditorHandle(new TextEditor());
     }
     ~TextEditorFactory() {}
 };
@@ -55,9 +90,9 @@ public:
 class BinaryEditorFactory : public EditorFactory
 {
 public:
-    std::unique_ptr<Editor> createEditor() override
+    EditorHandle createEditor() override
     {
-        return std::make_unique<BinaryEditor>();
+        return EditorHandle(new BinaryEditor());
     }
     ~BinaryEditorFactory() {}
 };
@@ -66,14 +101,349 @@ public:
 class PictureEditorFactory : public EditorFactory
 {
 public:
-    std::unique_ptr<Editor> createEditor() override
+    EditorHandle createEditor() override
     {
-        return std::make_unique<PictureEditor>();
+        return EditorHandle(new PictureEditor());
     }
     ~PictureEditorFactory() {}
 };
 
 
+struct PoolStats
+{
+    std::size_t allocations;    // objects created with new
+    std::size_t reuses;         // acquires served from a free list
+    std::size_t recycles;       // handles given back
+};
+
+/*
+ * per thread object pool: every thread keeps its own free list, so acquire/recycle need no lock.
+ * recycled editors are kept constructed(they are stateless), the next acquire hands them out again.
+ * a handle destroyed on another thread goes to that thread's free list. a list that grows past 2 * batch(a
+ * thread that only destroys) moves a batch to a shared central list, an empty one refills a batch from there
+ * before creating new editors(a thread that only creates): one lock per batch, like zeroalloc::PerThreadPool.
+ * objects left in a free list are deleted when its thread exits.
+ * the counters are per thread too(only the owner writes them, no locked instruction on the hot path),
+ * stats() sums them over the live threads plus the ones that already exited.
+ */
+template <class T>
+class EditorPool
+{
+public:
+    static T* acquire()
+    {
+        auto& list = local();
+        if(list.items.empty())
+            refill(list);
+        if(!list.items.empty())
+        {
+            auto* editor = list.items.back();
+            list.items.pop_back();
+            bump(list.reuses);
+            return editor;
+        }
+        bump(list.allocations);
+        return new T();
+    }
+    static void recycle(Editor* editor)
+    {
+        auto& list = local();
+        list.items.push_back(static_cast<T*>(editor));
+        bump(list.recycles);
+        if(list.items.size() > 2 * batch)
+        {
+            std::lock_guard<std::mutex> lk(centralLock);
+            central.items.insert(central.items.end(), list.items.end() - batch, list.items.end());
+            list.items.resize(list.items.size() - batch);
+        }
+    }
+    static PoolStats stats()
+    {
+        std::lock_guard<std::mutex> lk(registryLock);
+        PoolStats total = exited;
+        for(auto* list : registry)
+        {
+            total.allocations += list->allocations.load(std::memory_order_relaxed);
+            total.reuses += list->reuses.load(std::memory_order_relaxed);
+            total.recycles += list->recycles.load(std::memory_order_relaxed);
+        }
+        return total;
+    }
+private:
+    static constexpr std::size_t batch = 32;
+
+    struct FreeList
+    {
+        FreeList()
+        {
+            items.reserve(2 * batch + 1);
+            std::lock_guard<std::mutex> lk(registryLock);
+            registry.push_back(this);
+        }
+        ~FreeList()
+        {
+            for(auto* editor : items)
+                delete editor;
+            std::lock_guard<std::mutex> lk(registryLock);
+            exited.allocations += allocations.load(std::memory_order_relaxed);
+            exited.reuses += reuses.load(std::memory_order_relaxed);
+            exited.recycles += recycles.load(std::memory_order_relaxed);
+            registry.erase(std::find(registry.begin(), registry.end(), this));
+        }
+        std::vector<T*> items;
+        std::atomic<std::size_t> allocations{0};
+        std::atomic<std::size_t> reuses{0};
+        std::atomic<std::size_t> recycles{0};
+    };
+    static FreeList& local()
+    {
+        thread_local FreeList list;
+        return list;
+    }
+    static void refill(FreeList& list)
+    {
+        std::lock_guard<std::mutex> lk(centralLock);
+        auto n = std::min(batch, central.items.size());
+        list.items.insert(list.items.end(), central.items.end() - n, central.items.end());
+        central.items.resize(central.items.size() - n);
+    }
+    // single writer: a plain load + store, readable from stats() without a data race
+    static void bump(std::atomic<std::size_t>& counter)
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+    // editors handed back by threads that destroy more than they create, deleted at exit
+    struct Central
+    {
+        ~Central()
+        {
+            for(auto* editor : items)
+                delete editor;
+        }
+        std::vector<T*> items;
+    };
+    static inline std::mutex centralLock;
+    static inline Central central;
+    static inline std::mutex registryLock;
+    static inline std::vector<FreeList*> registry;
+    static inline PoolStats exited{0, 0, 0};
+};
+
+template <class T>
+class PooledEditorFactory : public EditorFactory
+{
+public:
+    EditorHandle createEditor() override
+    {
+        return EditorHandle(EditorPool<T>::acquire(), EditorRecycler(&EditorPool<T>::recycle));
+    }
+    static PoolStats stats() { return EditorPool<T>::stats(); }
+    ~PooledEditorFactory() {}
+};
+
+
+/*
+ * string keyed creation: types register themselves by name during static initialization,
+ * freeze() closes registration and builds a perfect hash table(hash and displace):
+ * + the name is hashed once(a word at a time), its high bits pick a bucket, the bucket's displacement mixed
+ *   with the hash picks the slot
+ * + every registered name owns a distinct slot, so a lookup is one mix, one slot and one string compare
+ * + after freeze() the table is read only, lookups take no lock
+ */
+template <class Value>
+class FrozenRegistry
+{
+public:
+    // false if the name is taken or registration is already closed
+    bool add(std::string_view name, Value value)
+    {
+        std::lock_guard<std::mutex> lk(lock);
+        if(isFrozen.load(std::memory_order_relaxed))
+            return false;
+        for(auto& entry : entries)
+            if(entry.name == name)
+                return false;
+        entries.push_back({std::string(name), hash(name), value});
+        return true;
+    }
+
+    void freeze()
+    {
+        std::lock_guard<std::mutex> lk(lock);
+        if(isFrozen.load(std::memory_order_relaxed))
+            return;
+        std::size_t tableSize = 1;
+        while(tableSize < 2 * entries.size())
+            tableSize <<= 1;
+        while(!build(tableSize))
+            tableSize <<= 1;
+        isFrozen.store(true, std::memory_order_release);
+    }
+
+    bool frozen() const { return isFrozen.load(std::memory_order_acquire); }
+
+    // lock free once frozen; before that it falls back to a locked scan.
+    // returns a copy: before freeze() a later add() may reallocate entries under a returned pointer
+    std::optional<Value> find(std::string_view name) const
+    {
+        auto h = hash(name);
+        if(!frozen())
+        {
+            std::lock_guard<std::mutex> lk(lock);
+            for(auto& entry : entries)
+                if(entry.name == name)
+                    return entry.value;
+            return std::nullopt;
+        }
+        auto& slot = slots[slotOf(h, displacement[bucketOf(h)])];
+        if(slot.hash != h || slot.entry == nullptr || slot.entry->name != name)
+            return std::nullopt;
+        return slot.entry->value;
+    }
+private:
+    // the biggest buckets first, try displacements until all of a bucket's keys land on free slots
+    bool build(std::size_t tableSize)
+    {
+        constexpr std::uint64_t maxDisplacement = 1 << 16;
+        const std::size_t n = entries.size();
+        std::size_t bucketCount = 1;
+        while(bucketCount < (n + 1) / 2)
+            bucketCount <<= 1;
+        mask = tableSize - 1;
+        bucketMask = bucketCount - 1;
+        slots.assign(tableSize, Slot{0, nullptr});
+        displacement.assign(bucketCount, 0);
+
+        std::vector<std::vector<std::int32_t>> buckets(bucketCount);
+        for(std::size_t i = 0; i < n; ++i)
+            buckets[bucketOf(entries[i].hash)].push_back(static_cast<std::int32_t>(i));
+        std::vector<std::size_t> order(bucketCount);
+        for(std::size_t b = 0; b < bucketCount; ++b)
+            order[b] = b;
+        std::sort(order.begin(), order.end(), [&](auto l, auto r) { return buckets[l].size() > buckets[r].size(); });
+
+        std::vector<std::size_t> candidate;
+        for(auto b : order)
+        {
+            if(buckets[b].empty())
+                break;
+            std::uint64_t d = 1;
+            for(; d < maxDisplacement; ++d)
+            {
+                candidate.clear();
+                bool ok = true;
+                for(auto idx : buckets[b])
+                {
+                    auto slot = slotOf(entries[idx].hash, d);
+                    if(slots[slot].entry != nullptr || std::find(candidate.begin(), candidate.end(), slot) != candidate.end())
+                    {
+                        ok = false;
+                        break;
+                    }
+                    candidate.push_back(slot);
+                }
+                if(ok)
+                    break;
+            }
+            if(d == maxDisplacement)
+                return false;       // retry with a bigger table
+            for(std::size_t k = 0; k < candidate.size(); ++k)
+                slots[candidate[k]] = {entries[buckets[b][k]].hash, &entries[buckets[b][k]]};
+            displacement[b] = d;
+        }
+        return true;
+    }
+
+    struct Entry
+    {
+        std::string name;
+        std::uint64_t hash;
+        Value value;
+    };
+
+    // 8 bytes per step, the last word is loaded overlapping so the tail needs no byte loop.
+    // finished with a full mix: the bucket comes from the high bits, those must depend on every byte
+    static std::uint64_t hash(std::string_view str)
+    {
+        auto* p = str.data();
+        auto n = str.size();
+        std::uint64_t h = 0x9e3779b97f4a7c15ull ^ n;
+        std::uint64_t word = 0;
+        if(n >= 8)
+        {
+            for(std::size_t i = 0; i + 8 < n; i += 8)
+            {
+                std::memcpy(&word, p + i, 8);
+                h = (h ^ word) * 0xbf58476d1ce4e5b9ull;
+                h ^= h >> 29;
+            }
+            std::memcpy(&word, p + n - 8, 8);
+        }
+        else
+        {
+            for(std::size_t i = 0; i < n; ++i)
+                word |= static_cast<std::uint64_t>(static_cast<unsigned char>(p[i])) << (8 * i);
+        }
+        return mix(h ^ word);
+    }
+    // splitmix64 finalizer
+    static std::uint64_t mix(std::uint64_t x)
+    {
+        x ^= x >> 30; x *= 0xbf58476d1ce4e5b9ull;
+        x ^= x >> 27; x *= 0x94d049bb133111ebull;
+        return x ^ (x >> 31);
+    }
+    std::size_t bucketOf(std::uint64_t h) const { return static_cast<std::size_t>(h >> 40) & bucketMask; }
+    std::size_t slotOf(std::uint64_t h, std::uint64_t d) const
+    {
+        return static_cast<std::size_t>(mix(h ^ (d * 0x9e3779b97f4a7c15ull)) & mask);
+    }
+
+    mutable std::mutex lock;
+    std::atomic<bool> isFrozen{false};
+    std::vector<Entry> entries;
+    // the hash is copied next to the entry pointer: a miss is rejected without touching the entry
+    struct Slot
+    {
+        std::uint64_t hash;
+        const Entry* entry;
+    };
+    std::vector<Slot> slots;
+    std::vector<std::uint64_t> displacement;
+    std::size_t mask = 0;
+    std::size_t bucketMask = 0;
+};
+
+using EditorCreator = EditorHandle (*)();
+
+FrozenRegistry<EditorCreator>& editorRegistry()
+{
+    static FrozenRegistry<EditorCreator> registry;
+    return registry;
+}
+
+template <class T>
+class EditorRegistrar
+{
+public:
+    explicit EditorRegistrar(std::string_view name)
+    {
+        editorRegistry().add(name, []() -> EditorHandle { return EditorHandle(new T()); });
+    }
+};
+
+// each editor registers itself, adding an editor doesn't touch any list elsewhere
+static EditorRegistrar<TextEditor> registerTextEditor("TextEditor");
+static EditorRegistrar<BinaryEditor> registerBinaryEditor("BinaryEditor");
+static EditorRegistrar<PictureEditor> registerPictureEditor("PictureEditor");
+
+EditorHandle createEditor(std::string_view typeName)
+{
+    auto creator = editorRegistry().find(typeName);
+    return creator ? (*creator)() : EditorHandle();
+}
+
+
 class Click
 {
 public:
@@ -91,7 +461,7 @@ public:
     ButtonClick(ButtonClick&& button) noexcept : factory(std::move(button.factory)) {}
     void click() override
     {
-        std::unique_ptr<Editor> text = factory->createEditor();
+        EditorHandle text = factory->createEditor();
         text->edit();
     }
     ~ButtonClick() {}
@@ -125,6 +495,22 @@ void mockApp()
 
 
 
+// the type names come from configuration or the wire
+void configApp()
+{
+    const std::string config[] = {"PictureEditor", "TextEditor", "BinaryEditor", "HexEditor"};
+    for(auto& typeName : config)
+    {
+        if(auto editor = createEditor(typeName))
+            editor->edit();
+        else
+            std::cout<<"unknown editor type: "<<typeName<<std::endl;
+    }
+}
+
+
+
+
 void dependConcreteClass()
 {
     // how to return a class object rather than explicit declaration.
@@ -140,8 +526,147 @@ void dependConcreteClass()
 
 
 
-int main()
+// the factory part of ButtonClick::click(), without the console output
+void benchmark(const char* name, EditorFactory& factory)
+{
+    constexpr int clicks = 1'000'000;
+    for(int i = 0; i < 16; ++i)         // warm up: fill the pool
+        factory.createEditor();
+    auto before = alloccount::allocations();
+    auto ns = bench::measureNs(5, [&]() {
+        for(int i = 0; i < clicks; ++i)
+        {
+            EditorHandle editor = factory.createEditor();
+            bench::doNotOptimize(editor.get());
+        }
+    });
+    std::printf("%-22s %8.2f ns/click %8.3f allocations/click\n", name, ns / clicks,
+                static_cast<double>(alloccount::allocations() - before) / (5.0 * clicks));
+}
+
+// one thread only creates, another only destroys: the destroyer's overflow has to come back to the creator
+// through the central list, otherwise the creator allocates forever and the destroyer's list grows forever
+void crossThreadBenchmark()
+{
+    constexpr int rounds = 2000, perRound = 256;
+    PooledEditorFactory<BinaryEditor> factory;
+    std::mutex lock;
+    std::vector<EditorHandle> handoff;
+    std::atomic<bool> done{false};
+    std::thread consumer([&]() {
+        std::vector<EditorHandle> batch;
+        while(true)
+        {
+            bool last = done.load();
+            {
+                std::lock_guard<std::mutex> lk(lock);
+                batch.swap(handoff);
+            }
+            if(batch.empty())
+            {
+                if(last)
+                    break;
+                std::this_thread::yield();
+                continue;
+            }
+            batch.clear();          // recycled on this thread
+        }
+    });
+    std::vector<EditorHandle> created;
+    for(int r = 0; r < rounds; ++r)
+    {
+        for(int i = 0; i < perRound; ++i)
+            created.push_back(factory.createEditor());
+        std::lock_guard<std::mutex> lk(lock);
+        std::move(created.begin(), created.end(), std::back_inserter(handoff));
+        created.clear();
+    }
+    done.store(true);
+    consumer.join();
+    auto stats = PooledEditorFactory<BinaryEditor>::stats();
+    std::printf("creator/destroyer threads: %zu editors created for %d handles, %zu reuses\n", stats.allocations,
+                rounds * perRound, stats.reuses);
+}
+
+EditorCreator ifElseLookup(std::string_view name)
+{
+    if(name == "TextEditor")
+        return []() -> EditorHandle { return EditorHandle(new TextEditor()); };
+    else if(name == "BinaryEditor")
+        return []() -> EditorHandle { return EditorHandle(new BinaryEditor()); };
+    else if(name == "PictureEditor")
+        return []() -> EditorHandle { return EditorHandle(new PictureEditor()); };
+    return nullptr;
+}
+
+// name -> creator lookup only, the names arrive in random order
+void lookupBenchmark()
+{
+    constexpr int lookups = 1'000'000;
+    auto run = [&](const char* name, const std::vector<std::string>& names, auto&& lookup) {
+        auto ns = bench::measureNs(5, [&]() {
+            for(int i = 0; i < lookups; ++i)
+                bench::doNotOptimize(lookup(names[i % names.size()]));
+        });
+        std::printf("%-40s %8.2f ns/lookup\n", name, ns / lookups);
+    };
+    std::mt19937 rng(42);
+
+    // the three real editors
+    std::vector<std::string> names;
+    for(int i = 0; i < 1024; ++i)
+        names.push_back(std::array{"TextEditor", "BinaryEditor", "PictureEditor"}[rng() % 3]);
+    std::unordered_map<std::string, EditorCreator> map;
+    for(auto& typeName : {"TextEditor", "BinaryEditor", "PictureEditor"})
+        map.emplace(typeName, *editorRegistry().find(typeName));
+    run("3 types: if/else", names, [](const std::string& n) { return ifElseLookup(n); });
+    run("3 types: unordered_map<string, fn>", names, [&](const std::string& n) { return map.find(n)->second; });
+    run("3 types: frozen perfect hash", names, [](const std::string& n) { return *editorRegistry().find(n); });
+
+    // a bigger registry: 256 type names, the if/else chain becomes a linear scan
+    std::vector<std::string> types;
+    for(int i = 0; i < 256; ++i)
+        types.push_back("app::editor::Type" + std::to_string(i));
+    FrozenRegistry<EditorCreator> big;
+    map.clear();
+    for(auto& t : types)
+    {
+        big.add(t, *editorRegistry().find("TextEditor"));
+        map.emplace(t, *editorRegistry().find("TextEditor"));
+    }
+    big.freeze();
+    names.clear();
+    for(int i = 0; i < 1024; ++i)
+        names.push_back(types[rng() % types.size()]);
+    run("256 types: linear scan", names, [&](const std::string& n) {
+        return std::find(types.begin(), types.end(), n) != types.end();
+    });
+    run("256 types: unordered_map<string, fn>", names, [&](const std::string& n) { return map.find(n)->second; });
+    run("256 types: frozen perfect hash", names, [&](const std::string& n) { return *big.find(n); });
+}
+
+// g++ "6. Factory Method.cpp" -std=c++20 -O2 -pthread
+// ./a.out bench
+int main(int argc, char** argv)
 {
+    editorRegistry().freeze();      // registration closes once main starts
     mockApp();
+    configApp();
+
+    ButtonClick pooled(std::make_unique<PooledEditorFactory<TextEditor>>());
+    pooled.click();
+    pooled.click();
+    auto stats = PooledEditorFactory<TextEditor>::stats();
+    std::cout<<"pool: allocations "<<stats.allocations<<", reuses "<<stats.reuses<<", recycles "<<stats.recycles<<std::endl;
+
+    if(argc > 1 && std::string(argv[1]) == "bench")
+    {
+        TextEditorFactory plain;
+        PooledEditorFactory<TextEditor> pool;
+        benchmark("TextEditorFactory", plain);
+        benchmark("PooledEditorFactory", pool);
+        crossThreadBenchmark();
+        lookupBenchmark();
+    }
     return 0;
 }
\ No newline at end of file
@@ -1,6 +1,13 @@
 #include <iostream>
 #include <string>
 #include <memory>
+#include <vector>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+#include "../Common/Bench.hpp"
 
 // UserType and UserRuler is interdependent...
 class User
@@ -27,20 +34,40 @@ public:
 
 
 
+// one customer in a billing run
+struct CustomerRecord
+{
+    std::uint64_t id;
+    double spend;
+};
+
+struct BillingResult
+{
+    double charge;
+    int priority;
+};
+
 class UserRuler
 {
 public:
     virtual void discount() const = 0;
     virtual void priority() const = 0;
+    virtual double discount(double spend) const = 0;     // the amount to charge
+    virtual int priority(double spend) const = 0;        // support queue priority, higher first
     virtual ~UserRuler() = default;
 };
 
 
+// the rules themselves are static, the virtual overrides and the batch loops share them
 class GoldenUserRuler : public UserRuler
 {
 public:
+    static double applyDiscount(double spend) { return spend * 0.80; }
+    static int applyPriority(double spend) { return 100 + static_cast<int>(spend * 0.001); }
     void discount() const override { std::cout<<"GoldenUser discount..."<<std::endl; }
     void priority() const override { std::cout<<"GoldenUser priority..."<<std::endl; }
+    double discount(double spend) const override { return applyDiscount(spend); }
+    int priority(double spend) const override { return applyPriority(spend); }
     ~GoldenUserRuler() {}
 };
 
@@ -48,8 +75,12 @@ public:
 class SilverUserRuler : public UserRuler
 {
 public:
+    static double applyDiscount(double spend) { return spend * 0.90; }
+    static int applyPriority(double spend) { return 10 + static_cast<int>(spend * 0.001); }
     void discount() const override { std::cout<<"SilverUser discount..."<<std::endl; }
     void priority() const override { std::cout<<"SilverUser priority..."<<std::endl; }
+    double discount(double spend) const override { return applyDiscount(spend); }
+    int priority(double spend) const override { return applyPriority(spend); }
     ~SilverUserRuler() {}
 };
 
@@ -108,6 +139,13 @@ public:
         userRuler->discount();
         userRuler->priority();
     }
+    // the per object path: two heap allocations and two virtual calls per customer
+    BillingResult bill(const CustomerRecord& record) const
+    {
+        std::unique_ptr<User> user = factory->CreateUser();
+        std::unique_ptr<UserRuler> userRuler = factory->CreateUserRuler();
+        return {userRuler->discount(record.spend), userRuler->priority(record.spend)};
+    }
 private:
     std::unique_ptr<UserAndRulerFactory> factory;
 };
@@ -116,7 +154,124 @@ private:
 
 
 
-int main()
+/*
+ * batch billing: users are stored struct-of-arrays and grouped by tier, each tier is one tight loop
+ * over contiguous columns with the tier's rules inlined, no allocation and no virtual call per customer.
+ */
+enum class Tier { Golden, Silver };
+
+struct TierColumns
+{
+    std::vector<std::uint64_t> id;
+    std::vector<double> spend;
+    std::vector<double> charge;
+    std::vector<int> priority;
+
+    void add(const CustomerRecord& record)
+    {
+        id.push_back(record.id);
+        spend.push_back(record.spend);
+    }
+    void clear()
+    {
+        id.clear();
+        spend.clear();
+        charge.clear();
+        priority.clear();
+    }
+    std::size_t size() const { return id.size(); }
+};
+
+class UserTable
+{
+public:
+    void add(Tier tier, const CustomerRecord& record) { (tier == Tier::Golden ? golden : silver).add(record); }
+    void clear() { golden.clear(); silver.clear(); }
+    TierColumns golden;
+    TierColumns silver;
+};
+
+class BatchCalculation
+{
+public:
+    void calculation(UserTable& table) const
+    {
+        run<GoldenUserRuler>(table.golden);
+        run<SilverUserRuler>(table.silver);
+    }
+private:
+    template <class Ruler>
+    static void run(TierColumns& tier)
+    {
+        const auto n = tier.size();
+        tier.charge.resize(n);
+        tier.priority.resize(n);
+        const double* spend = tier.spend.data();
+        double* charge = tier.charge.data();
+        int* priority = tier.priority.data();
+        for(std::size_t i = 0; i < n; ++i)
+            charge[i] = Ruler::applyDiscount(spend[i]);
+        for(std::size_t i = 0; i < n; ++i)
+            priority[i] = Ruler::applyPriority(spend[i]);
+    }
+};
+
+
+void benchmark(std::size_t n)
+{
+    std::mt19937_64 rng(42);
+    std::uniform_real_distribution<double> spend(0.0, 10000.0);
+    std::vector<CustomerRecord> records(n);
+    std::vector<Tier> tiers(n);
+    for(std::size_t i = 0; i < n; ++i)
+    {
+        records[i] = {i, spend(rng)};
+        tiers[i] = rng() % 4 == 0 ? Tier::Golden : Tier::Silver;
+    }
+
+    Calculation goldenCal(std::make_unique<GoldenUserAndRulerFactory>());
+    Calculation silverCal(std::make_unique<SilverUserAndRulerFactory>());
+    std::vector<BillingResult> results(n);
+    auto perObject = bench::measureNs(5, [&]() {
+        for(std::size_t i = 0; i < n; ++i)
+            results[i] = (tiers[i] == Tier::Golden ? goldenCal : silverCal).bill(records[i]);
+        bench::clobberMemory();
+    });
+
+    UserTable table;
+    auto group = bench::measureNs(5, [&]() {
+        table.clear();
+        for(std::size_t i = 0; i < n; ++i)
+            table.add(tiers[i], records[i]);
+        bench::clobberMemory();
+    });
+    BatchCalculation batch;
+    auto batched = bench::measureNs(5, [&]() {
+        batch.calculation(table);
+        bench::clobberMemory();
+    });
+
+    // same numbers either way
+    for(auto* tier : {&table.golden, &table.silver})
+        for(std::size_t i = 0; i < tier->size(); ++i)
+        {
+            auto& expect = results[tier->id[i]];
+            if(expect.charge != tier->charge[i] || expect.priority != tier->priority[i])
+                std::abort();
+        }
+    if(table.golden.size() + table.silver.size() != n)
+        std::abort();
+
+    std::printf("per object(alloc + virtual): %8.2f ns/user\n", perObject / n);
+    std::printf("group into SoA by tier:      %8.2f ns/user\n", group / n);
+    std::printf("batch per tier loops:        %8.2f ns/user\n", batched / n);
+}
+
+
+
+// g++ "7. Abstract Factory.cpp" -std=c++20 -O2
+// ./a.out bench [users = 4M]
+int main(int argc, char** argv)
 {
     auto goldenFactory = std::make_unique<GoldenUserAndRulerFactory>();
     auto silverFactory = std::make_unique<SilverUserAndRulerFactory>();
@@ -127,5 +282,8 @@ int main()
     goldenCal.calculation();
     std::cout<<"-------------------------------\n";
     silverCal.calculation();
+
+    if(argc > 1 && std::string(argv[1]) == "bench")
+        benchmark(argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 4 * 1024 * 1024);
     return 0;
 }
\ No newline at end of file
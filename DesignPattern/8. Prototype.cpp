@@ -1,13 +1,103 @@
 #include <iostream>
 #include <memory>
 #include <string>
+#include <string_view>
+#include <span>
+#include <vector>
+#include <atomic>
+#include <utility>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <functional>
+#include <type_traits>
+#include <cstddef>
+#include <cstdint>
 #include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+#include "../Common/Bench.hpp"
+#include "../Common/AllocCount.hpp"
+
+/*
+ * caller supplied storage for clones: a bump allocator over a fixed buffer.
+ * objects with a destructor get a finalizer record next to them, reset() runs them(newest first)
+ * and rewinds. create() returns nullptr when the buffer is full, nothing is allocated on the heap.
+ */
+class Arena
+{
+public:
+    Arena(void* _buffer, std::size_t _capacity) : buffer(static_cast<std::byte*>(_buffer)), capacity(_capacity) {}
+    template <std::size_t N>
+    explicit Arena(std::byte (&arr)[N]) : Arena(arr, N) {}
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+    ~Arena() { reset(); }
+
+    template <class T, class... Args>
+    T* create(Args&&... args)
+    {
+        auto mark = length;
+        Finalizer* finalizer = nullptr;
+        if constexpr(!std::is_trivially_destructible_v<T>)
+            finalizer = static_cast<Finalizer*>(allocate(sizeof(Finalizer), alignof(Finalizer)));
+        void* storage = allocate(sizeof(T), alignof(T));
+        if(storage == nullptr || (!std::is_trivially_destructible_v<T> && finalizer == nullptr))
+        {
+            length = mark;
+            return nullptr;
+        }
+        auto* object = ::new (storage) T(std::forward<Args>(args)...);
+        if constexpr(!std::is_trivially_destructible_v<T>)
+        {
+            finalizer->destroy = [](void* p) { static_cast<T*>(p)->~T(); };
+            finalizer->object = object;
+            finalizer->next = finalizers;
+            finalizers = finalizer;
+        }
+        return object;
+    }
+    void reset()
+    {
+        for(auto* f = finalizers; f != nullptr; f = f->next)
+            f->destroy(f->object);
+        finalizers = nullptr;
+        length = 0;
+    }
+    std::size_t used() const { return length; }
+private:
+    struct Finalizer
+    {
+        void (*destroy)(void*);
+        void* object;
+        Finalizer* next;
+    };
+    void* allocate(std::size_t size, std::size_t align)
+    {
+        auto offset = (length + align - 1) & ~(align - 1);
+        if(offset > capacity || size > capacity - offset)
+            return nullptr;
+        length = offset + size;
+        return buffer + offset;
+    }
+    std::byte* buffer;
+    std::size_t capacity;
+    std::size_t length = 0;
+    Finalizer* finalizers = nullptr;
+};
+
+
 
 class User
 {
 public:
     virtual void UserDoing() const = 0;
     virtual std::unique_ptr<User> clone() const = 0;
+    virtual User* cloneInto(Arena& arena) const = 0;      // nullptr when the arena is full
+    virtual std::string_view getName() const = 0;
+    virtual std::span<const char> getConfig() const = 0;
     virtual ~User() = default;
 };
 
@@ -16,22 +106,28 @@ public:
 class GoldenUser : public User
 {
 public:
-    explicit GoldenUser(std::string _name) : name(_name) {}
-    GoldenUser(const GoldenUser& goldenUser) : name(goldenUser.name) {}
+    explicit GoldenUser(std::string _name, std::vector<char> _config = {}) : name(_name), config(std::move(_config)) {}
+    GoldenUser(const GoldenUser& goldenUser) : name(goldenUser.name), config(goldenUser.config) {}
     GoldenUser& operator=(const GoldenUser& goldenUser)
     {
         this->name = goldenUser.name;
+        this->config = goldenUser.config;
         return *this;
     }
     void UserDoing() const override { std::cout<<name<<std::endl; }
     void setName(std::string _name) { this->name = _name; }
+    void setConfig(std::size_t pos, char value) { config[pos] = value; }
+    std::string_view getName() const override { return name; }
+    std::span<const char> getConfig() const override { return config; }
     std::unique_ptr<User> clone() const override
     {
         return std::make_unique<GoldenUser>(*this);
     }
+    User* cloneInto(Arena& arena) const override { return arena.create<GoldenUser>(*this); }
     ~GoldenUser() {}
 private:
     std::string name;
+    std::vector<char> config;
 };
 
 
@@ -40,22 +136,260 @@ private:
 class SilverUser : public User
 {
 public:
-    explicit SilverUser(std::string _name) : name(_name) {}
-    SilverUser(const SilverUser& silverUser) : name(silverUser.name) {}
+    explicit SilverUser(std::string _name, std::vector<char> _config = {}) : name(_name), config(std::move(_config)) {}
+    SilverUser(const SilverUser& silverUser) : name(silverUser.name), config(silverUser.config) {}
     SilverUser& operator=(const SilverUser& silverUser)
     {
         this->name = silverUser.name;
+        this->config = silverUser.config;
         return *this;
     }
     void UserDoing() const override { std::cout<<name<<std::endl; }
     void setName(std::string _name) { this->name = _name; }
+    void setConfig(std::size_t pos, char value) { config[pos] = value; }
+    std::string_view getName() const override { return name; }
+    std::span<const char> getConfig() const override { return config; }
     std::unique_ptr<User> clone() const override
     {
         return std::make_unique<SilverUser>(*this);
     }
+    User* cloneInto(Arena& arena) const override { return arena.create<SilverUser>(*this); }
     ~SilverUser() {}
 private:
     std::string name;
+    std::vector<char> config;
+};
+
+
+
+/*
+ * fixed size blocks recycled through a per thread free list, no lock on the fast path.
+ * a block freed on another thread joins that thread's list. a list longer than 2 * batch hands batch blocks
+ * to a mutex guarded central list, an empty list takes a batch from there before calling operator new: a
+ * thread that only frees(the epoch retire, the last CowPtr owner) doesn't hoard blocks the allocating
+ * threads need. the lists are plain pointers(trivially destructible), so blocks freed after the thread's
+ * cleanup ran(e.g. by a static object at exit) go straight back to operator delete; blocks still on the
+ * central list at exit stay reachable from it.
+ */
+template <std::size_t Size>
+class FixedPool
+{
+public:
+    static void* allocate()
+    {
+        if(head == nullptr)
+            refill();
+        if(auto* node = head)
+        {
+            head = node->next;
+            --count;
+            return node;
+        }
+        return ::operator new(Size);
+    }
+    static void deallocate(void* p)
+    {
+        if(exiting)
+        {
+            ::operator delete(p);
+            return;
+        }
+        reaper();
+        head = new (p) Node{head};
+        if(++count > 2 * batch)
+            spill();
+    }
+private:
+    static constexpr std::size_t batch = 32;
+
+    struct Node
+    {
+        Node* next;
+    };
+    static_assert(Size >= sizeof(Node));
+    // the first batch nodes of the local list go to the central list
+    static void spill()
+    {
+        Node* first = head;
+        Node* last = head;
+        for(std::size_t i = 1; i < batch; ++i)
+            last = last->next;
+        head = last->next;
+        count -= batch;
+        std::lock_guard<std::mutex> lk(centralLock);
+        last->next = centralHead;
+        centralHead = first;
+    }
+    static void refill()
+    {
+        std::lock_guard<std::mutex> lk(centralLock);
+        for(std::size_t i = 0; i < batch && centralHead != nullptr; ++i)
+        {
+            auto* node = centralHead;
+            centralHead = node->next;
+            node->next = head;
+            head = node;
+            ++count;
+        }
+    }
+    struct Reaper
+    {
+        ~Reaper()
+        {
+            exiting = true;
+            while(head != nullptr)
+            {
+                auto* next = head->next;
+                ::operator delete(head);
+                head = next;
+            }
+            count = 0;
+        }
+    };
+    static Reaper& reaper()
+    {
+        thread_local Reaper r;
+        return r;
+    }
+    static inline thread_local Node* head = nullptr;
+    static inline thread_local std::size_t count = 0;
+    static inline thread_local bool exiting = false;
+    static inline std::mutex centralLock;
+    static inline Node* centralHead = nullptr;
+};
+
+// class specific new/delete from FixedPool, a derived class of another size falls back to the global heap
+template <class Derived>
+class Pooled
+{
+public:
+    static void* operator new(std::size_t size)
+    {
+        return size == sizeof(Derived) ? FixedPool<sizeof(Derived)>::allocate() : ::operator new(size);
+    }
+    static void operator delete(void* p, std::size_t size)
+    {
+        if(size == sizeof(Derived))
+            FixedPool<sizeof(Derived)>::deallocate(p);
+        else
+            ::operator delete(p);
+    }
+};
+
+
+/*
+ * copy on write handle: copies share one immutable refcounted block, copying the handle is one atomic increment.
+ * mutate() copies the block first if it is shared, assign() just replaces it(nothing old to keep).
+ * the blocks come from FixedPool, the value's own heap storage(string/vector buffer) does not.
+ */
+template <class T>
+class CowPtr
+{
+public:
+    explicit CowPtr(T value) : block(new Block(std::move(value))) {}
+    CowPtr(const CowPtr& other) noexcept : block(other.block) { block->refs.fetch_add(1, std::memory_order_relaxed); }
+    CowPtr& operator=(const CowPtr& other) noexcept
+    {
+        CowPtr copy(other);
+        std::swap(block, copy.block);
+        return *this;
+    }
+    ~CowPtr() { release(); }
+    const T& operator*() const { return block->value; }
+    const T* operator->() const { return &block->value; }
+    T& mutate()
+    {
+        if(!unique())
+        {
+            auto* copy = new Block(block->value);
+            release();
+            block = copy;
+        }
+        return block->value;
+    }
+    void assign(T value)
+    {
+        if(unique())
+        {
+            block->value = std::move(value);
+            return;
+        }
+        auto* fresh = new Block(std::move(value));
+        release();
+        block = fresh;
+    }
+    // acquire: pairs with the release in other owners' fetch_sub, their reads are done before we write
+    bool unique() const { return block->refs.load(std::memory_order_acquire) == 1; }
+    bool sharesWith(const CowPtr& other) const { return block == other.block; }
+private:
+    struct Block : Pooled<Block>
+    {
+        template <class U>
+        explicit Block(U&& _value) : value(std::forward<U>(_value)) {}
+        std::atomic<std::size_t> refs{1};
+        T value;
+    };
+    void release()
+    {
+        if(block->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            delete block;
+    }
+    Block* block;
+};
+
+
+/*
+ * the name and the config are separate blocks: renaming a clone never copies its(large) config,
+ * the config is copied once, on the first setConfig of a clone that still shares it.
+ * clone() = a pooled object + two refcount increments, whatever the config size.
+ */
+class SharedGoldenUser : public User, public Pooled<SharedGoldenUser>
+{
+public:
+    using Pooled<SharedGoldenUser>::operator new;
+    using Pooled<SharedGoldenUser>::operator delete;
+    explicit SharedGoldenUser(std::string _name, std::vector<char> _config = {}) : name(std::move(_name)), config(std::move(_config)) {}
+    void UserDoing() const override { std::cout<<*name<<std::endl; }
+    void setName(std::string _name) { name.assign(std::move(_name)); }
+    void setConfig(std::size_t pos, char value) { config.mutate()[pos] = value; }
+    std::string_view getName() const override { return *name; }
+    std::span<const char> getConfig() const override { return *config; }
+    bool sharesConfigWith(const SharedGoldenUser& other) const { return config.sharesWith(other.config); }
+    std::unique_ptr<User> clone() const override
+    {
+        return std::make_unique<SharedGoldenUser>(*this);
+    }
+    User* cloneInto(Arena& arena) const override { return arena.create<SharedGoldenUser>(*this); }
+    ~SharedGoldenUser() {}
+private:
+    CowPtr<std::string> name;
+    CowPtr<std::vector<char>> config;
+};
+
+
+
+
+class SharedSilverUser : public User, public Pooled<SharedSilverUser>
+{
+public:
+    using Pooled<SharedSilverUser>::operator new;
+    using Pooled<SharedSilverUser>::operator delete;
+    explicit SharedSilverUser(std::string _name, std::vector<char> _config = {}) : name(std::move(_name)), config(std::move(_config)) {}
+    void UserDoing() const override { std::cout<<*name<<std::endl; }
+    void setName(std::string _name) { name.assign(std::move(_name)); }
+    void setConfig(std::size_t pos, char value) { config.mutate()[pos] = value; }
+    std::string_view getName() const override { return *name; }
+    std::span<const char> getConfig() const override { return *config; }
+    bool sharesConfigWith(const SharedSilverUser& other) const { return config.sharesWith(other.config); }
+    std::unique_ptr<User> clone() const override
+    {
+        return std::make_unique<SharedSilverUser>(*this);
+    }
+    User* cloneInto(Arena& arena) const override { return arena.create<SharedSilverUser>(*this); }
+    ~SharedSilverUser() {}
+private:
+    CowPtr<std::string> name;
+    CowPtr<std::vector<char>> config;
 };
 
 
@@ -75,7 +409,438 @@ private:
 
 
 
-int main()
+/*
+ * epoch based reclamation for the prototype cache: a reader announces the current epoch in its own
+ * slot(one per thread, on its own cache line, no shared write), a writer retires an object together
+ * with a new epoch and frees it once every announcing reader has moved past that epoch.
+ * neither side waits for the other, retired objects are freed by later writers(or the destructor).
+ * there is one domain per process shared by every cache, writers of different caches retire concurrently:
+ * the retired list is guarded by the domain's own mutex.
+ */
+class EpochDomain
+{
+    struct Slot;
+public:
+    class Guard
+    {
+    public:
+        Guard() : slot(local())
+        {
+            if(slot.depth++ == 0)
+                slot.announced.store(instance().global.load());
+        }
+        Guard(const Guard&) = delete;
+        Guard& operator=(const Guard&) = delete;
+        ~Guard()
+        {
+            if(--slot.depth == 0)
+                slot.announced.store(0, std::memory_order_release);
+        }
+    private:
+        Slot& slot;
+    };
+
+    static EpochDomain& instance()
+    {
+        static EpochDomain domain;
+        return domain;
+    }
+    ~EpochDomain()
+    {
+        for(auto& r : retired)
+            r.destroy();
+        for(auto* slot = slots.load(); slot != nullptr;)
+        {
+            auto* next = slot->next;
+            delete slot;
+            slot = next;
+        }
+    }
+    // any thread, destroy runs later on some writer's thread(under the retire lock, it must not retire)
+    void retire(std::function<void()> destroy)
+    {
+        std::lock_guard<std::mutex> lk(retireLock);
+        auto epoch = global.fetch_add(1) + 1;
+        retired.push_back({epoch, std::move(destroy)});
+        reclaim();
+    }
+private:
+    friend class Guard;
+    struct alignas(64) Slot
+    {
+        std::atomic<std::uint64_t> announced{0};      // 0: not reading
+        std::atomic<bool> inUse{true};
+        unsigned depth = 0;
+        Slot* next = nullptr;
+    };
+    struct Retired
+    {
+        std::uint64_t epoch;
+        std::function<void()> destroy;
+    };
+    // a thread takes a free slot(or adds one) on its first read and gives it back when it exits
+    struct Owner
+    {
+        Owner() : slot(instance().acquireSlot()) {}
+        ~Owner() { slot->inUse.store(false, std::memory_order_release); }
+        Slot* slot;
+    };
+    static Slot& local()
+    {
+        thread_local Owner owner;
+        return *owner.slot;
+    }
+    Slot* acquireSlot()
+    {
+        for(auto* slot = slots.load(std::memory_order_acquire); slot != nullptr; slot = slot->next)
+        {
+            bool expect = false;
+            if(!slot->inUse.load(std::memory_order_relaxed) && slot->inUse.compare_exchange_strong(expect, true))
+                return slot;
+        }
+        auto* slot = new Slot();
+        slot->next = slots.load(std::memory_order_relaxed);
+        while(!slots.compare_exchange_weak(slot->next, slot, std::memory_order_release, std::memory_order_relaxed))
+            ;
+        return slot;
+    }
+    // retireLock held
+    void reclaim()
+    {
+        auto oldest = ~std::uint64_t{0};
+        for(auto* slot = slots.load(std::memory_order_acquire); slot != nullptr; slot = slot->next)
+            if(auto e = slot->announced.load(); e != 0)
+                oldest = std::min(oldest, e);
+        std::size_t kept = 0;
+        for(auto& r : retired)
+        {
+            if(r.epoch <= oldest)
+                r.destroy();
+            else
+                retired[kept++] = std::move(r);
+        }
+        retired.resize(kept);
+    }
+    std::atomic<std::uint64_t> global{1};
+    std::atomic<Slot*> slots{nullptr};
+    std::mutex retireLock;                  // guards retired
+    std::vector<Retired> retired;
+};
+
+/*
+ * many named prototypes, keyed by configuration.
+ * readers: announce an epoch, load the current table, find the key, clone -- no lock and no shared write.
+ * writers: copy the table under a mutex, publish the new one, retire the old one. a hot swap never waits
+ * for readers, a reader that still holds the old table keeps cloning the old prototype until it is done.
+ */
+class PrototypeCache
+{
+public:
+    PrototypeCache() : table(new Table()) {}
+    PrototypeCache(const PrototypeCache&) = delete;
+    PrototypeCache& operator=(const PrototypeCache&) = delete;
+    ~PrototypeCache() { delete table.load(); }
+
+    // add or hot swap
+    void put(std::string key, std::unique_ptr<User> prototype)
+    {
+        std::lock_guard<std::mutex> lk(writeLock);
+        auto* next = new Table(*table.load());
+        (*next)[std::move(key)] = std::shared_ptr<const User>(std::move(prototype));
+        publish(next);
+    }
+    bool erase(std::string_view key)
+    {
+        std::lock_guard<std::mutex> lk(writeLock);
+        auto* cur = table.load();
+        auto it = cur->find(key);
+        if(it == cur->end())
+            return false;
+        auto* next = new Table(*cur);
+        next->erase(next->find(key));
+        publish(next);
+        return true;
+    }
+    // nullptr if the key is unknown or the arena is full
+    User* clone(std::string_view key, Arena& arena) const
+    {
+        EpochDomain::Guard guard;
+        auto* cur = table.load();
+        auto it = cur->find(key);
+        return it == cur->end() ? nullptr : it->second->cloneInto(arena);
+    }
+    std::unique_ptr<User> clone(std::string_view key) const
+    {
+        EpochDomain::Guard guard;
+        auto* cur = table.load();
+        auto it = cur->find(key);
+        return it == cur->end() ? nullptr : it->second->clone();
+    }
+private:
+    struct KeyHash
+    {
+        using is_transparent = void;
+        std::size_t operator()(std::string_view key) const { return std::hash<std::string_view>{}(key); }
+    };
+    using Table = std::unordered_map<std::string, std::shared_ptr<const User>, KeyHash, std::equal_to<>>;
+    void publish(Table* next)
+    {
+        auto* old = table.exchange(next);
+        EpochDomain::instance().retire([old]() { delete old; });
+    }
+    std::atomic<Table*> table;
+    std::mutex writeLock;
+};
+
+
+// read the name and a few bytes spread over the config, like a request handler looking up its settings
+long readUser(const User& user)
+{
+    auto config = user.getConfig();
+    long sum = static_cast<long>(user.getName().size());
+    for(std::size_t i = 0; i < config.size(); i += config.size() / 8 + 1)
+        sum += config[i];
+    return sum;
+}
+
+template <class Deep, class Shared>
+void benchmarkSize(std::size_t size)
+{
+    const int iters = static_cast<int>(std::clamp<std::size_t>((std::size_t{1} << 26) / size, 200, 100000));
+    const std::string renamed = "a renamed user, too long for the small string buffer";
+    Deep deep("prototype user", std::vector<char>(size, 'x'));
+    Shared shared("prototype user", std::vector<char>(size, 'x'));
+    const User& deepProto = deep;
+    const User& sharedProto = shared;
+
+    // warm the pools so the steady state is measured
+    for(int i = 0; i < 4; ++i)
+    {
+        auto d = deepProto.clone();
+        auto s = sharedProto.clone();
+        static_cast<Shared&>(*s).setName(renamed);
+        static_cast<Shared&>(*s).setConfig(0, 'y');
+    }
+
+    double result[5];
+    double allocs[5];
+    auto run = [&](int column, auto&& body) {
+        auto before = alloccount::allocations();
+        result[column] = bench::measureNs(5, [&]() {
+            for(int i = 0; i < iters; ++i)
+                body();
+        }) / iters;
+        allocs[column] = static_cast<double>(alloccount::allocations() - before) / (5.0 * iters);
+    };
+    run(0, [&]() {
+        auto user = deepProto.clone();
+        bench::doNotOptimize(readUser(*user));
+    });
+    run(1, [&]() {
+        auto user = sharedProto.clone();
+        bench::doNotOptimize(readUser(*user));
+    });
+    run(2, [&]() {
+        auto user = deepProto.clone();
+        static_cast<Deep&>(*user).setName(renamed);
+        bench::doNotOptimize(readUser(*user));
+    });
+    run(3, [&]() {
+        auto user = sharedProto.clone();
+        static_cast<Shared&>(*user).setName(renamed);
+        bench::doNotOptimize(readUser(*user));
+    });
+    run(4, [&]() {
+        auto user = sharedProto.clone();
+        static_cast<Shared&>(*user).setConfig(size / 2, 'y');
+        bench::doNotOptimize(readUser(*user));
+    });
+    if(readUser(*deepProto.clone()) != readUser(*sharedProto.clone()))
+        std::abort();
+
+    std::printf("%8zu", size);
+    for(int i = 0; i < 5; ++i)
+        std::printf(" %11.1f %6.1f", result[i], allocs[i]);
+    std::printf("\n");
+}
+
+// what we had: one mutex around a map, every clone takes it
+class MutexPrototypeCache
+{
+public:
+    void put(std::string key, std::unique_ptr<User> prototype)
+    {
+        std::lock_guard<std::mutex> lk(lock);
+        prototypes[std::move(key)] = std::move(prototype);
+    }
+    std::unique_ptr<User> clone(const std::string& key) const
+    {
+        std::lock_guard<std::mutex> lk(lock);
+        auto it = prototypes.find(key);
+        return it == prototypes.end() ? nullptr : it->second->clone();
+    }
+private:
+    mutable std::mutex lock;
+    std::unordered_map<std::string, std::unique_ptr<User>> prototypes;
+};
+
+// `threads` readers clone round robin over 64 keys, optionally one writer hot swaps a prototype every 10us
+template <class Cache, class CloneFn>
+void benchmarkCache(const char* name, int threads, bool swapping, CloneFn cloneOne)
+{
+    constexpr int keys = 64;
+    constexpr int iters = 200000;
+    std::vector<std::string> names;
+    Cache cache;
+    for(int i = 0; i < keys; ++i)
+    {
+        names.push_back("config-" + std::to_string(i));
+        cache.put(names.back(), std::make_unique<SharedGoldenUser>(names.back(), std::vector<char>(4096, 'x')));
+    }
+
+    std::atomic<bool> stop{false};
+    std::size_t swaps = 0;
+    std::thread writer;
+    if(swapping)
+        writer = std::thread([&]() {
+            for(int i = 0; !stop.load(std::memory_order_relaxed); ++i)
+            {
+                cache.put(names[i % keys], std::make_unique<SharedGoldenUser>(names[i % keys], std::vector<char>(4096, 'y')));
+                ++swaps;
+                std::this_thread::sleep_for(std::chrono::microseconds(10));
+            }
+        });
+
+    auto start = bench::Clock::now();
+    std::vector<std::thread> readers;
+    for(int t = 0; t < threads; ++t)
+        readers.emplace_back([&, t]() {
+            alignas(std::max_align_t) std::byte storage[1024];
+            Arena arena(storage);
+            long sum = 0;
+            for(int i = 0; i < iters; ++i)
+            {
+                sum += cloneOne(cache, names[(i + t) % keys], arena);
+                arena.reset();
+            }
+            bench::doNotOptimize(sum);
+        });
+    for(auto& reader : readers)
+        reader.join();
+    auto elapsed = std::chrono::duration<double, std::nano>(bench::Clock::now() - start).count();
+    stop.store(true);
+    if(writer.joinable())
+        writer.join();
+
+    auto total = static_cast<double>(iters) * threads;
+    std::printf("%-22s %8d %8s %12.1f %12.2f %8zu\n", name, threads, swapping ? "yes" : "no", elapsed / total,
+                total / elapsed * 1e3, swaps);
+}
+
+// every cache retires into the one EpochDomain: writers of two caches on two threads retire at the same time
+void twoCacheSwap()
+{
+    PrototypeCache caches[2];
+    std::vector<std::thread> writers;
+    for(auto& cache : caches)
+        writers.emplace_back([&cache]() {
+            for(int i = 0; i < 20000; ++i)
+            {
+                cache.put("golden", std::make_unique<SharedGoldenUser>("golden"));
+                bench::doNotOptimize(cache.clone("golden"));
+            }
+        });
+    for(auto& writer : writers)
+        writer.join();
+    std::printf("two caches hot swapped from two threads: 2 x 20000 swaps\n");
+}
+
+// one thread allocates CowPtr-sized blocks, another frees them: the blocks come back through the central list
+void crossThreadPool()
+{
+    using Pool = FixedPool<64>;
+    constexpr std::size_t rounds = 2000, perRound = 256;
+    std::mutex lock;
+    std::vector<void*> handoff, created;
+    handoff.reserve(rounds * perRound);         // no vector growth inside the count
+    created.reserve(perRound);
+    std::atomic<bool> done{false};
+    std::atomic<std::size_t> freed{0};
+    auto before = alloccount::allocations();
+    std::thread destroyer([&]() {
+        std::vector<void*> batch;
+        batch.reserve(rounds * perRound);
+        while(true)
+        {
+            bool last = done.load();
+            {
+                std::lock_guard<std::mutex> lk(lock);
+                batch.swap(handoff);
+            }
+            if(batch.empty())
+            {
+                if(last)
+                    break;
+                std::this_thread::yield();
+                continue;
+            }
+            for(auto* p : batch)
+                Pool::deallocate(p);
+            freed.fetch_add(batch.size());
+            batch.clear();
+        }
+    });
+    for(std::size_t r = 0; r < rounds; ++r)
+    {
+        for(std::size_t i = 0; i < perRound; ++i)
+            created.push_back(Pool::allocate());
+        {
+            std::lock_guard<std::mutex> lk(lock);
+            handoff.insert(handoff.end(), created.begin(), created.end());
+        }
+        created.clear();
+        // steady state: at most two rounds alive, the rest has to be recycled
+        while(freed.load() + perRound < (r + 1) * perRound)
+            std::this_thread::yield();
+    }
+    done.store(true);
+    destroyer.join();
+    std::printf("allocating/freeing threads: %zu blocks, %zu from operator new\n", rounds * perRound,
+                alloccount::allocations() - before - 2);       // - the destroyer thread and its batch
+}
+
+void benchmark()
+{
+    twoCacheSwap();
+    crossThreadPool();
+    std::printf("%8s %18s %18s %18s %18s %18s\n", "", "deep clone+read", "cow clone+read", "deep +setName", "cow +setName", "cow +setConfig");
+    std::printf("%8s", "config");
+    for(int i = 0; i < 5; ++i)
+        std::printf(" %11s %6s", "ns", "allocs");
+    std::printf("\n");
+    for(std::size_t size : {16, 256, 4096, 65536, 1 << 20})
+        benchmarkSize<GoldenUser, SharedGoldenUser>(size);
+
+    std::printf("\n%-22s %8s %8s %12s %12s %8s\n", "cache", "readers", "swapping", "ns/clone", "Mclones/s", "swaps");
+    for(bool swapping : {false, true})
+        for(int threads : {1, 2, 4, 8})
+        {
+            benchmarkCache<MutexPrototypeCache>("mutex + map", threads, swapping,
+                [](const MutexPrototypeCache& cache, const std::string& key, Arena&) {
+                    return static_cast<long>(cache.clone(key)->getName().size());
+                });
+            benchmarkCache<PrototypeCache>("PrototypeCache+arena", threads, swapping,
+                [](const PrototypeCache& cache, const std::string& key, Arena& arena) {
+                    return static_cast<long>(cache.clone(key, arena)->getName().size());
+                });
+        }
+}
+
+
+
+// g++ "8. Prototype.cpp" -std=c++20 -O2 -pthread
+// ./a.out bench    clone cost for configs of 16B..1MB(deep copy vs copy on write), then the prototype cache
+int main(int argc, char** argv)
 {
     auto goldenUser = std::make_unique<GoldenUser>("Golden User...");
     goldenUser->UserDoing();
@@ -87,5 +852,33 @@ int main()
     newUser->UserDoing();
     std::cout<<goldenUser.get()<<std::endl;
     std::cout<<newUser.get()<<std::endl;
+
+    // the clone shares the prototype's state until one of them writes
+    SharedSilverUser silverUser("Silver User...", std::vector<char>(1024, 'x'));
+    auto sharedClone = silverUser.clone();
+    auto& sharedUser = static_cast<SharedSilverUser&>(*sharedClone);
+    std::cout<<"shares config after clone:\t"<<sharedUser.sharesConfigWith(silverUser)<<std::endl;
+    sharedUser.setName("renamed Silver User...");
+    std::cout<<"shares config after setName:\t"<<sharedUser.sharesConfigWith(silverUser)<<std::endl;
+    sharedUser.setConfig(0, 'y');
+    std::cout<<"shares config after setConfig:\t"<<sharedUser.sharesConfigWith(silverUser)<<std::endl;
+    silverUser.UserDoing();
+    sharedUser.UserDoing();
+
+    // many prototypes by key, cloned into a stack buffer, swapped while in use
+    PrototypeCache cache;
+    cache.put("golden", std::make_unique<SharedGoldenUser>("cached Golden User..."));
+    cache.put("silver", std::make_unique<SharedSilverUser>("cached Silver User..."));
+    alignas(std::max_align_t) std::byte storage[256];
+    Arena arena(storage);
+    auto* cachedGolden = cache.clone("golden", arena);
+    cache.put("golden", std::make_unique<SharedGoldenUser>("swapped Golden User..."));
+    cachedGolden->UserDoing();
+    cache.clone("golden", arena)->UserDoing();
+    cache.clone("silver")->UserDoing();
+    std::cout<<"unknown key:\t"<<(cache.clone("bronze", arena) == nullptr)<<std::endl;
+
+    if(argc > 1 && std::string(argv[1]) == "bench")
+        benchmark();
     return 0;
-}
\ No newline at end of file
+}
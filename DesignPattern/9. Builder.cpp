@@ -2,6 +2,23 @@
 #include <vector>
 #include <memory>
 #include <string>
+#include <string_view>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <array>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <algorithm>
+#include <cstdint>
+
+#include "../Common/Bench.hpp"
+#include "../Common/AllocCount.hpp"
 
 class House
 {
@@ -109,7 +126,522 @@ private:
 };
 
 
-int main()
+/*
+ * work stealing pool: every worker owns a deque, it pushes and pops its own tasks at the back(LIFO, warm cache)
+ * and steals from the front of the others when it runs dry. a task submitted from outside the pool goes to
+ * the workers round robin. the deques are mutex protected, the locks are per worker and almost never contended.
+ */
+class WorkStealingPool
+{
+public:
+    explicit WorkStealingPool(unsigned _threads = std::max(2u, std::thread::hardware_concurrency()))
+    {
+        for(unsigned i = 0; i < _threads; ++i)
+            workers.push_back(std::make_unique<Worker>());
+        for(unsigned i = 0; i < _threads; ++i)
+            threads.emplace_back([this, i]() { loop(i); });
+    }
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+    ~WorkStealingPool()
+    {
+        {
+            std::lock_guard<std::mutex> lk(sleepLock);
+            stopping = true;
+        }
+        wake.notify_all();
+        for(auto& t : threads)
+            t.join();
+    }
+    void submit(std::function<void()> task)
+    {
+        auto target = currentPool == this ? currentWorker : next.fetch_add(1, std::memory_order_relaxed) % workers.size();
+        {
+            std::lock_guard<std::mutex> lk(workers[target]->lock);
+            workers[target]->tasks.push_back(std::move(task));
+        }
+        {
+            std::lock_guard<std::mutex> lk(sleepLock);
+            ++pending;
+        }
+        wake.notify_one();
+    }
+    std::size_t size() const { return workers.size(); }
+    std::size_t steals() const { return stolen.load(std::memory_order_relaxed); }
+private:
+    struct alignas(64) Worker
+    {
+        std::mutex lock;
+        std::deque<std::function<void()>> tasks;
+    };
+    bool take(std::size_t self, std::function<void()>& task)
+    {
+        {
+            std::lock_guard<std::mutex> lk(workers[self]->lock);
+            if(!workers[self]->tasks.empty())
+            {
+                task = std::move(workers[self]->tasks.back());
+                workers[self]->tasks.pop_back();
+                return true;
+            }
+        }
+        for(std::size_t i = 1; i < workers.size(); ++i)
+        {
+            auto& victim = *workers[(self + i) % workers.size()];
+            std::lock_guard<std::mutex> lk(victim.lock);
+            if(!victim.tasks.empty())
+            {
+                task = std::move(victim.tasks.front());
+                victim.tasks.pop_front();
+                stolen.fetch_add(1, std::memory_order_relaxed);
+                return true;
+            }
+        }
+        return false;
+    }
+    void loop(std::size_t self)
+    {
+        currentPool = this;
+        currentWorker = self;
+        std::function<void()> task;
+        while(true)
+        {
+            {
+                std::unique_lock<std::mutex> lk(sleepLock);
+                wake.wait(lk, [&]() { return stopping || pending != 0; });
+                if(pending == 0)
+                    return;
+                --pending;
+            }
+            // pending counted one queued task for us, it may sit in any deque
+            while(!take(self, task))
+                std::this_thread::yield();
+            task();
+        }
+    }
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::vector<std::thread> threads;
+    std::atomic<std::size_t> next{0};
+    std::atomic<std::size_t> stolen{0};
+    std::mutex sleepLock;
+    std::condition_variable wake;
+    std::size_t pending = 0;
+    bool stopping = false;
+    static inline thread_local const WorkStealingPool* currentPool = nullptr;
+    static inline thread_local std::size_t currentWorker = 0;
+};
+
+
+// which of step1..step5 must finish before which, steps are numbered 1..5 like the builder's methods
+class StepGraph
+{
+public:
+    static constexpr int steps = 5;
+
+    // the old HouseDirector order: step1 -> step2 -> ... -> step5
+    static StepGraph sequential()
+    {
+        StepGraph graph;
+        for(int step = 2; step <= steps; ++step)
+            graph.addDependency(step, step - 1);
+        return graph;
+    }
+    // false(and no change) if a step is out of range or the edge would close a cycle
+    bool addDependency(int step, int prerequisite)
+    {
+        if(step < 1 || step > steps || prerequisite < 1 || prerequisite > steps || reaches(prerequisite, step))
+            return false;
+        before[step - 1] |= 1u << (prerequisite - 1);
+        return true;
+    }
+    bool dependsOn(int step, int prerequisite) const { return before[step - 1] >> (prerequisite - 1) & 1u; }
+private:
+    // does `from` depend on `to`, directly or through other steps
+    bool reaches(int from, int to) const
+    {
+        if(from == to)
+            return true;
+        for(int p = 1; p <= steps; ++p)
+            if(dependsOn(from, p) && reaches(p, to))
+                return true;
+        return false;
+    }
+    std::array<unsigned, steps> before{};
+};
+
+struct StepTiming
+{
+    std::uint64_t startNs;      // relative to the start of Construct()
+    std::uint64_t durationNs;
+};
+
+struct ConstructReport
+{
+    std::array<StepTiming, StepGraph::steps> steps{};
+    std::uint64_t wallNs = 0;
+    std::uint64_t criticalPathNs = 0;   // longest chain of measured step durations through the graph
+    std::uint64_t totalStepNs = 0;      // what running them one after another would take
+};
+
+/*
+ * runs the steps as the graph allows: a step is submitted to the pool once all its prerequisites are done,
+ * independent steps run at the same time. every step writes its own field, so the house equals the one the
+ * sequential HouseDirector builds whatever the order.
+ */
+class ParallelHouseDirector
+{
+public:
+    ParallelHouseDirector(std::unique_ptr<HouseBuilder> _houseBuilder, StepGraph _graph, WorkStealingPool& _pool)
+        : houseBuilder(std::move(_houseBuilder)), graph(_graph), pool(_pool) {}
+    std::unique_ptr<House> Construct()
+    {
+        constexpr int n = StepGraph::steps;
+        std::array<std::atomic<int>, n> waiting;
+        for(int step = 1; step <= n; ++step)
+        {
+            int count = 0;
+            for(int p = 1; p <= n; ++p)
+                count += graph.dependsOn(step, p);
+            waiting[step - 1].store(count, std::memory_order_relaxed);
+        }
+        std::mutex doneLock;
+        std::condition_variable allDone;
+        int remaining = n;
+        auto start = bench::nowNs();
+
+        std::function<void(int)> run = [&](int step) {
+            auto begin = bench::nowNs();
+            (houseBuilder.get()->*stepFunctions[step - 1])();
+            auto end = bench::nowNs();
+            lastReport.steps[step - 1] = {begin - start, end - begin};
+            for(int next = 1; next <= n; ++next)
+                if(graph.dependsOn(next, step) && waiting[next - 1].fetch_sub(1, std::memory_order_acq_rel) == 1)
+                    pool.submit([&run, next]() { run(next); });
+            // notify under the lock: Construct() can't return(and destroy all this) before we let go of it
+            std::lock_guard<std::mutex> lk(doneLock);
+            if(--remaining == 0)
+                allDone.notify_one();
+        };
+        // pick the roots before submitting any: once step1 runs, the workers start zeroing the others' counters
+        std::array<int, n> roots{};
+        int rootCount = 0;
+        for(int step = 1; step <= n; ++step)
+            if(waiting[step - 1].load(std::memory_order_relaxed) == 0)
+                roots[rootCount++] = step;
+        for(int i = 0; i < rootCount; ++i)
+            pool.submit([&run, step = roots[i]]() { run(step); });
+        {
+            std::unique_lock<std::mutex> lk(doneLock);
+            allDone.wait(lk, [&]() { return remaining == 0; });
+        }
+
+        lastReport.wallNs = bench::nowNs() - start;
+        lastReport.totalStepNs = 0;
+        std::array<std::uint64_t, n> finish{};
+        lastReport.criticalPathNs = 0;
+        for(int step : topologicalOrder())
+        {
+            std::uint64_t ready = 0;
+            for(int p = 1; p <= n; ++p)
+                if(graph.dependsOn(step, p))
+                    ready = std::max(ready, finish[p - 1]);
+            finish[step - 1] = ready + lastReport.steps[step - 1].durationNs;
+            lastReport.criticalPathNs = std::max(lastReport.criticalPathNs, finish[step - 1]);
+            lastReport.totalStepNs += lastReport.steps[step - 1].durationNs;
+        }
+        return houseBuilder->getHouse();
+    }
+    const ConstructReport& report() const { return lastReport; }
+private:
+    std::array<int, StepGraph::steps> topologicalOrder() const
+    {
+        std::array<int, StepGraph::steps> order{};
+        unsigned placed = 0;
+        for(int i = 0; i < StepGraph::steps; ++i)
+            for(int step = 1; step <= StepGraph::steps; ++step)
+            {
+                bool ready = !(placed >> (step - 1) & 1u);
+                for(int p = 1; ready && p <= StepGraph::steps; ++p)
+                    ready = !graph.dependsOn(step, p) || (placed >> (p - 1) & 1u);
+                if(ready)
+                {
+                    order[i] = step;
+                    placed |= 1u << (step - 1);
+                    break;
+                }
+            }
+        return order;
+    }
+    static constexpr void (HouseBuilder::*stepFunctions[StepGraph::steps])() const = {
+        &HouseBuilder::step1, &HouseBuilder::step2, &HouseBuilder::step3, &HouseBuilder::step4, &HouseBuilder::step5};
+    std::unique_ptr<HouseBuilder> houseBuilder;
+    StepGraph graph;
+    WorkStealingPool& pool;
+    ConstructReport lastReport;
+};
+
+
+/*
+ * zero allocation path: the house is built directly in caller supplied storage.
+ * the steps only store string literals, so the fields are string_views(no copy, no allocation),
+ * and the builders are stateless, one const builder can serve any number of houses and threads.
+ */
+class CompactHouse
+{
+public:
+    virtual void Other() = 0;
+    void Print()    // for debug
+    {
+        std::cout<<step1_para<<std::endl;
+        std::cout<<step2_para<<std::endl;
+        std::cout<<step3_para<<std::endl;
+        std::cout<<step4_para<<std::endl;
+        std::cout<<step5_para<<std::endl;
+    }
+    virtual ~CompactHouse() = default;
+
+    // must point at static storage
+    std::string_view step1_para;
+    std::string_view step2_para;
+    std::string_view step3_para;
+    std::string_view step4_para;
+    std::string_view step5_para;
+};
+
+class CompactStoneHouse final : public CompactHouse
+{
+public:
+    void Other() override { std::cout<<"StoneHouse other......"<<std::endl; }
+    ~CompactStoneHouse() {}
+};
+
+class CompactCrystalHouse final : public CompactHouse
+{
+public:
+    void Other() override { std::cout<<"CrystalHouse other......"<<std::endl; }
+    ~CompactCrystalHouse() {}
+};
+
+
+
+class InPlaceHouseBuilder
+{
+public:
+    // bytes one house takes in caller storage(storage must be aligned to max_align_t)
+    virtual std::size_t houseSize() const = 0;
+    virtual CompactHouse* build(void* storage) const = 0;
+    // n houses back to back, n * houseSize() bytes, houses[i] receives the i-th one
+    virtual void buildMany(std::size_t n, void* storage, CompactHouse** houses) const = 0;
+    virtual ~InPlaceHouseBuilder() = default;
+};
+
+// the five steps run in the same order as HouseDirector::Construct, called directly on the concrete builder
+template <class Derived, class ConcreteHouse>
+class InPlaceHouseBuilderBase : public InPlaceHouseBuilder
+{
+public:
+    static constexpr std::size_t stride = (sizeof(ConcreteHouse) + alignof(std::max_align_t) - 1) / alignof(std::max_align_t) * alignof(std::max_align_t);
+    std::size_t houseSize() const override { return stride; }
+    CompactHouse* build(void* storage) const override { return make(storage); }
+    void buildMany(std::size_t n, void* storage, CompactHouse** houses) const override
+    {
+        auto* bytes = static_cast<std::byte*>(storage);
+        for(std::size_t i = 0; i < n; ++i)
+            houses[i] = make(bytes + i * stride);
+    }
+private:
+    ConcreteHouse* make(void* storage) const
+    {
+        auto* house = ::new (storage) ConcreteHouse();
+        auto& builder = static_cast<const Derived&>(*this);
+        builder.step1(*house);
+        builder.step2(*house);
+        builder.step3(*house);
+        builder.step4(*house);
+        builder.step5(*house);
+        return house;
+    }
+};
+
+
+class InPlaceStoneHouseBuilder final : public InPlaceHouseBuilderBase<InPlaceStoneHouseBuilder, CompactStoneHouse>
+{
+public:
+    ~InPlaceStoneHouseBuilder() {}
+    void step1(CompactHouse& house) const { house.step1_para = "StoneHouse:111"; }
+    void step2(CompactHouse& house) const { house.step2_para = "StoneHouse:222"; }
+    void step3(CompactHouse& house) const { house.step3_para = "StoneHouse:333"; }
+    void step4(CompactHouse& house) const { house.step4_para = "StoneHouse:444"; }
+    void step5(CompactHouse& house) const { house.step5_para = "StoneHouse:555"; }
+};
+
+
+class InPlaceCrystalHouseBuilder final : public InPlaceHouseBuilderBase<InPlaceCrystalHouseBuilder, CompactCrystalHouse>
+{
+public:
+    ~InPlaceCrystalHouseBuilder() {}
+    void step1(CompactHouse& house) const { house.step1_para = "CrystalHouse:111"; }
+    void step2(CompactHouse& house) const { house.step2_para = "CrystalHouse:222"; }
+    void step3(CompactHouse& house) const { house.step3_para = "CrystalHouse:333"; }
+    void step4(CompactHouse& house) const { house.step4_para = "CrystalHouse:444"; }
+    void step5(CompactHouse& house) const { house.step5_para = "CrystalHouse:555"; }
+};
+
+
+// the caller owns the storage and destroys the houses(Destroy) before reusing it
+class InPlaceHouseDirector
+{
+public:
+    explicit InPlaceHouseDirector(const InPlaceHouseBuilder& _houseBuilder) : houseBuilder(_houseBuilder) {}
+    std::size_t HouseSize() const { return houseBuilder.houseSize(); }
+    // nullptr if the storage is too small
+    CompactHouse* Construct(void* storage, std::size_t size) const
+    {
+        if(size < houseBuilder.houseSize())
+            return nullptr;
+        return houseBuilder.build(storage);
+    }
+    // as many of the n houses as fit, returns how many were built
+    std::size_t ConstructMany(std::size_t n, void* storage, std::size_t size, CompactHouse** houses) const
+    {
+        n = std::min(n, size / houseBuilder.houseSize());
+        houseBuilder.buildMany(n, storage, houses);
+        return n;
+    }
+    static void Destroy(CompactHouse* house) { house->~CompactHouse(); }
+private:
+    const InPlaceHouseBuilder& houseBuilder;
+};
+
+
+
+template <class Builder, class InPlaceBuilder>
+void benchmark(const char* name)
+{
+    constexpr std::size_t batch = 4096;
+    constexpr int rounds = 10;
+    const double houses = static_cast<double>(batch) * rounds;
+    const double measured = houses * 5;
+
+    auto before = alloccount::allocations();
+    auto classic = bench::measureNs(5, [&]() {
+        for(int r = 0; r < rounds; ++r)
+            for(std::size_t i = 0; i < batch; ++i)
+            {
+                HouseDirector director(std::make_unique<Builder>());
+                bench::doNotOptimize(director.Construct());
+            }
+    });
+    auto classicAllocs = static_cast<double>(alloccount::allocations() - before) / measured;
+
+    // the builder is created once, the in place path has no per house object besides the house
+    const InPlaceBuilder builder;
+    InPlaceHouseDirector director(builder);
+    std::vector<CompactHouse*> built(batch);
+    auto storage = std::make_unique<std::byte[]>(director.HouseSize() * batch);
+
+    before = alloccount::allocations();
+    auto single = bench::measureNs(5, [&]() {
+        for(int r = 0; r < rounds; ++r)
+            for(std::size_t i = 0; i < batch; ++i)
+            {
+                auto* house = director.Construct(&storage[i * director.HouseSize()], director.HouseSize());
+                bench::doNotOptimize(house);
+                InPlaceHouseDirector::Destroy(house);
+            }
+    });
+    auto singleAllocs = static_cast<double>(alloccount::allocations() - before) / measured;
+
+    before = alloccount::allocations();
+    auto many = bench::measureNs(5, [&]() {
+        for(int r = 0; r < rounds; ++r)
+        {
+            director.ConstructMany(batch, storage.get(), director.HouseSize() * batch, built.data());
+            bench::clobberMemory();
+            for(auto* house : built)
+                InPlaceHouseDirector::Destroy(house);
+        }
+    });
+    auto manyAllocs = static_cast<double>(alloccount::allocations() - before) / measured;
+
+    director.ConstructMany(batch, storage.get(), director.HouseSize() * batch, built.data());
+    auto reference = HouseDirector(std::make_unique<Builder>()).Construct();
+    if(built.back()->step5_para != reference->step5_para)
+        std::abort();
+
+    std::printf("%-13s %10.1f %8.1f %10.1f %8.1f %10.1f %8.1f\n", name, classic / houses, classicAllocs,
+                single / houses, singleAllocs, many / houses, manyAllocs);
+}
+
+
+// every step also does a fixed amount of work, standing in for an expensive independent computation
+template <class Builder>
+class SlowBuilder : public Builder
+{
+public:
+    explicit SlowBuilder(std::array<std::uint64_t, StepGraph::steps> _work) : work(_work) {}
+    void step1() const override { burn(work[0]); Builder::step1(); }
+    void step2() const override { burn(work[1]); Builder::step2(); }
+    void step3() const override { burn(work[2]); Builder::step3(); }
+    void step4() const override { burn(work[3]); Builder::step4(); }
+    void step5() const override { burn(work[4]); Builder::step5(); }
+    ~SlowBuilder() {}
+private:
+    static void burn(std::uint64_t iterations)
+    {
+        std::uint64_t x = iterations;
+        for(std::uint64_t i = 0; i < iterations; ++i)
+        {
+            x = x * 6364136223846793005ull + 1442695040888963407ull;
+            bench::doNotOptimize(x);
+        }
+    }
+    std::array<std::uint64_t, StepGraph::steps> work;
+};
+
+void dagBenchmark()
+{
+    const std::array<std::uint64_t, StepGraph::steps> work{2000000, 4000000, 3000000, 1000000, 2000000};
+    WorkStealingPool pool(4);
+
+    StepGraph diamond;      // step1 -> {step2, step3, step4} -> step5
+    for(int step : {2, 3, 4})
+    {
+        diamond.addDependency(step, 1);
+        diamond.addDependency(5, step);
+    }
+    if(diamond.addDependency(1, 5))     // would close a cycle
+        std::abort();
+
+    auto sequentialStart = bench::nowNs();
+    auto reference = HouseDirector(std::make_unique<SlowBuilder<CrystalHouseBuilder>>(work)).Construct();
+    auto sequentialNs = bench::nowNs() - sequentialStart;
+    std::printf("\nHouseDirector(sequential): %.2f ms, pool of %zu workers, hardware threads %u\n", sequentialNs / 1e6,
+                pool.size(), std::thread::hardware_concurrency());
+    std::printf("%-12s %9s %9s %9s   per step start+duration(ms)\n", "graph", "wall(ms)", "sum(ms)", "crit(ms)");
+
+    std::pair<const char*, StepGraph> graphs[] = {{"sequential", StepGraph::sequential()}, {"diamond", diamond}, {"independent", StepGraph()}};
+    for(auto& [name, graph] : graphs)
+    {
+        ParallelHouseDirector director(std::make_unique<SlowBuilder<CrystalHouseBuilder>>(work), graph, pool);
+        auto house = director.Construct();
+        if(house->step1_para != reference->step1_para || house->step2_para != reference->step2_para ||
+           house->step3_para != reference->step3_para || house->step4_para != reference->step4_para ||
+           house->step5_para != reference->step5_para)
+            std::abort();
+        auto& report = director.report();
+        std::printf("%-12s %9.2f %9.2f %9.2f  ", name, report.wallNs / 1e6, report.totalStepNs / 1e6, report.criticalPathNs / 1e6);
+        for(auto& step : report.steps)
+            std::printf(" %.1f+%.1f", step.startNs / 1e6, step.durationNs / 1e6);
+        std::printf("\n");
+    }
+    std::printf("steals: %zu\n", pool.steals());
+}
+
+
+// g++ "9. Builder.cpp" -std=c++20 -O2 -pthread
+// ./a.out bench    allocations and ns per house(classic director vs in place construction), then the step graph
+int main(int argc, char** argv)
 {
     auto stoneHouse = std::make_unique<HouseDirector>(std::make_unique<StoneHouseBuilder>())->Construct();
     stoneHouse->Print();
@@ -117,6 +649,30 @@ int main()
     auto crystalHouse = std::make_unique<HouseDirector>(std::make_unique<CrystalHouseBuilder>())->Construct();
     crystalHouse->Print();
 
+    // built in a stack buffer, no heap allocation
+    const InPlaceCrystalHouseBuilder builder;
+    InPlaceHouseDirector director(builder);
+    alignas(std::max_align_t) std::byte storage[256];
+    auto* compactHouse = director.Construct(storage, sizeof(storage));
+    compactHouse->Print();
+    compactHouse->Other();
+    InPlaceHouseDirector::Destroy(compactHouse);
+
+    // step1 first, then the other four at the same time on the pool
+    WorkStealingPool pool;
+    StepGraph graph;
+    for(int step = 2; step <= StepGraph::steps; ++step)
+        graph.addDependency(step, 1);
+    ParallelHouseDirector parallelDirector(std::make_unique<StoneHouseBuilder>(), graph, pool);
+    parallelDirector.Construct()->Print();
+
+    if(argc > 1 && std::string(argv[1]) == "bench")
+    {
+        std::printf("%-13s %10s %8s %10s %8s %10s %8s\n", "", "classic ns", "allocs", "in place", "allocs", "many", "allocs");
+        benchmark<StoneHouseBuilder, InPlaceStoneHouseBuilder>("StoneHouse");
+        benchmark<CrystalHouseBuilder, InPlaceCrystalHouseBuilder>("CrystalHouse");
+        dagBenchmark();
+    }
     return 0;
 }
 
@@ -1,23 +1,204 @@
 #include <iostream>
+#include <algorithm>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <functional>
 #include <future>
+#include <mutex>
+#include <string>
 #include <thread>
 #include <vector>
 
+#include "../../../Common/Bench.hpp"
+
 constexpr auto tenMillion = 10'000'000;
-bool doWork(std::function<bool(int)>filter, int maxVal = tenMillion)
+
+// who runs the parts of doWork
+enum class Launch { Thread, Async, Pool };
+
+const char* name(Launch launch)
+{
+    switch(launch)
+    {
+    case Launch::Thread: return "std::jthread";
+    case Launch::Async: return "std::async";
+    case Launch::Pool: return "thread pool";
+    }
+    return "?";
+}
+
+// fixed number of workers, one shared queue: parts are reused threads instead of new ones per call
+class ThreadPool
+{
+public:
+    explicit ThreadPool(unsigned _threads)
+    {
+        for(unsigned i = 0; i < _threads; ++i)
+            workers.emplace_back([this]() { loop(); });
+    }
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lk(lock);
+            stopping = true;
+        }
+        wake.notify_all();
+        for(auto& t : workers)
+            t.join();
+    }
+    static ThreadPool& shared()
+    {
+        static ThreadPool pool(std::max(1u, std::thread::hardware_concurrency()));
+        return pool;
+    }
+    std::future<void> submit(std::function<void()> task)
+    {
+        std::packaged_task<void()> packaged(std::move(task));
+        auto future = packaged.get_future();
+        {
+            std::lock_guard<std::mutex> lk(lock);
+            tasks.push_back(std::move(packaged));
+        }
+        wake.notify_one();
+        return future;
+    }
+    std::size_t size() const { return workers.size(); }
+private:
+    void loop()
+    {
+        while(true)
+        {
+            std::packaged_task<void()> task;
+            {
+                std::unique_lock<std::mutex> lk(lock);
+                wake.wait(lk, [this]() { return stopping || !tasks.empty(); });
+                if(tasks.empty())
+                    return;
+                task = std::move(tasks.front());
+                tasks.pop_front();
+            }
+            task();
+        }
+    }
+    std::vector<std::thread> workers;
+    std::deque<std::packaged_task<void()>> tasks;
+    std::mutex lock;
+    std::condition_variable wake;
+    bool stopping = false;
+};
+
+/*
+ * part(0) ... part(parts - 1) at the same time, returns when all of them finished. every path waits:
+ * jthread joins in its destructor(Item 37: the old doWork's std::thread was still joinable when it was
+ * destroyed -> std::terminate), async/pool wait on their futures, get() rethrows what a part threw.
+ */
+template <class Part>
+void runParts(Launch launch, unsigned parts, Part&& part)
 {
-    std::vector<int> goodVals;
-    std::thread t([&filter, maxVal, &goodVals]
-                  {
-                      for(auto i = 0; i <= maxVal; ++i)
-                        if(filter(i))
-                            goodVals.push_back(i);
-                  });
+    if(launch == Launch::Thread)
+    {
+        std::vector<std::jthread> threads;
+        for(unsigned i = 0; i < parts; ++i)
+            threads.emplace_back([&part, i]() { part(i); });
+        return;
+    }
+    std::vector<std::future<void>> futures;
+    for(unsigned i = 0; i < parts; ++i)
+    {
+        if(launch == Launch::Async)
+            futures.push_back(std::async(std::launch::async, [&part, i]() { part(i); }));     // Item 36: not the default policy
+        else
+            futures.push_back(ThreadPool::shared().submit([&part, i]() { part(i); }));
+    }
+    for(auto& f : futures)
+        f.get();
 }
 
-int main()
+/*
+ * all i in [0, maxVal] with filter(i), ascending. the range is cut into `parts` slices:
+ * 1. every part filters its slice into its own buffer(no sharing, no locking)
+ * 2. exclusive prefix sum over the buffer sizes = where each part's values start in the result
+ * 3. every part copies its buffer to that offset, in parallel again
+ */
+std::vector<int> doWork(std::function<bool(int)> filter, int maxVal = tenMillion,
+                        unsigned parts = std::max(1u, std::thread::hardware_concurrency()), Launch launch = Launch::Async)
 {
-    
+    if(maxVal < 0)
+        return {};
+    parts = std::max(1u, parts);
+    auto count = static_cast<long long>(maxVal) + 1;
+    std::vector<std::vector<int>> local(parts);
+    runParts(launch, parts, [&](unsigned part) {
+        // long long: the last part ends at INT_MAX + 1 when maxVal == INT_MAX
+        auto begin = count * part / parts;
+        auto end = count * (part + 1) / parts;
+        auto& out = local[part];
+        for(auto i = begin; i < end; ++i)
+            if(filter(static_cast<int>(i)))
+                out.push_back(static_cast<int>(i));
+    });
 
+    std::vector<std::size_t> offset(parts + 1, 0);
+    for(unsigned part = 0; part < parts; ++part)
+        offset[part + 1] = offset[part] + local[part].size();
+
+    std::vector<int> goodVals(offset[parts]);
+    runParts(launch, parts, [&](unsigned part) {
+        std::copy(local[part].begin(), local[part].end(), goodVals.begin() + offset[part]);
+    });
+    return goodVals;
+}
+
+
+// ten million candidates, ms per doWork and speedup over one core for every launch policy
+void benchmark(unsigned maxCores, int repeat)
+{
+    auto filter = [](int i) {
+        // a little work per element: is the digit sum divisible by 7
+        int sum = 0;
+        for(; i != 0; i /= 10)
+            sum += i % 10;
+        return sum % 7 == 0;
+    };
+    std::vector<int> expected;
+    for(auto i = 0; i <= tenMillion; ++i)
+        if(filter(i))
+            expected.push_back(i);
+
+    std::printf("%-14s %6s %10s %9s\n", "launch", "cores", "ms", "speedup");
+    for(auto launch : {Launch::Thread, Launch::Async, Launch::Pool})
+    {
+        double oneCore = 0;
+        for(unsigned cores = 1; cores <= maxCores; ++cores)
+        {
+            std::vector<int> goodVals;
+            auto ns = bench::measureNs(repeat, [&]() { goodVals = doWork(filter, tenMillion, cores, launch); });
+            if(goodVals != expected)
+            {
+                std::printf("%s with %u cores: wrong result\n", name(launch), cores);
+                std::exit(1);
+            }
+            if(cores == 1)
+                oneCore = ns;
+            std::printf("%-14s %6u %10.2f %8.2fx%s\n", name(launch), cores, ns / 1e6, oneCore / ns,
+                        launch == Launch::Pool && cores > ThreadPool::shared().size() ? "   (more parts than pool workers)" : "");
+        }
+    }
+}
+
+// g++ concurrency.cpp -std=c++20 -O2 -pthread
+// ./a.out bench [max cores = hardware_concurrency] [repeat = 5]
+int main(int argc, char** argv)
+{
+    auto goodVals = doWork([](int i) { return i % 1'000'000 == 0; });
+    for(auto v : goodVals)
+        std::cout<<v<<" ";
+    std::cout<<std::endl;
+
+    if(argc > 1 && std::string(argv[1]) == "bench")
+        benchmark(argc > 2 ? std::atoi(argv[2]) : std::max(1u, std::thread::hardware_concurrency()),
+                  argc > 3 ? std::atoi(argv[3]) : 5);
     return 0;
-}
\ No newline at end of file
+}
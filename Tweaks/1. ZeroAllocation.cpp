@@ -0,0 +1,193 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory_resource>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ZeroAllocation.hpp"
+#include "../Common/Bench.hpp"
+#include "../Common/Perf.hpp"
+
+/*
+ * the run<Alloc> of "1. ZeroAllocation.md", grown up: mixed object sizes(70% 16..64B, 25% ..256B, 5% ..1KB),
+ * the last 64 objects stay alive, a "request" is 256 allocations and frees everything at its end.
+ * 1..N threads do this at the same time, each through the resource of its row:
+ * + malloc:                           std::pmr::new_delete_resource(), shared
+ * + pmr::synchronized_pool_resource:  the standard thread safe pool, shared
+ * + pmr::monotonic_buffer_resource:   one per thread on a 64KB stack buffer, release() per request
+ * + RequestArena:                     one per thread, reset() per request
+ * + StaticFreeList<1024, 64>:         one per thread, 64 blocks of the largest size
+ * + PerThreadPool:                    shared, per thread free lists
+ * and the object cache(slab) against new/delete of an object with an expensive constructor.
+ *
+ * g++ "1. ZeroAllocation.cpp" -std=c++20 -O2 -pthread
+ * ./a.out [allocations per thread = 4M] [max threads = hardware_concurrency]
+ */
+
+constexpr std::size_t window = 64;
+constexpr std::size_t perRequest = 256;
+
+std::vector<std::uint16_t> mixedSizes()
+{
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<int> percent(0, 99);
+    std::vector<std::uint16_t> sizes(4096);
+    for(auto& size : sizes)
+    {
+        auto p = percent(rng);
+        auto max = p < 70 ? 64 : p < 95 ? 256 : 1024;
+        size = static_cast<std::uint16_t>(std::uniform_int_distribution<int>(16, max)(rng));
+    }
+    return sizes;
+}
+
+// one thread's share of the work
+template <class EndOfRequest>
+void workload(std::pmr::memory_resource& resource, std::size_t ops, const std::vector<std::uint16_t>& sizes,
+              EndOfRequest&& endOfRequest)
+{
+    struct Live
+    {
+        void* ptr = nullptr;
+        std::size_t size = 0;
+    };
+    Live live[window];
+    auto freeAll = [&]() {
+        for(auto& object : live)
+            if(object.ptr != nullptr)
+            {
+                resource.deallocate(object.ptr, object.size);
+                object.ptr = nullptr;
+            }
+    };
+    for(std::size_t i = 0; i < ops; ++i)
+    {
+        auto& object = live[i % window];
+        if(object.ptr != nullptr)
+            resource.deallocate(object.ptr, object.size);
+        object.size = sizes[i % sizes.size()];
+        object.ptr = resource.allocate(object.size);
+        static_cast<char*>(object.ptr)[0] = static_cast<char>(i);     // touch it, like a constructor would
+        bench::doNotOptimize(object.ptr);
+        if((i + 1) % perRequest == 0)
+        {
+            freeAll();
+            endOfRequest();
+        }
+    }
+    freeAll();
+}
+
+// ns per allocate+deallocate seen by one thread, all threads running body(ops) at once.
+// every worker counts itself under "name xN"(the counters are per thread)
+double run(const std::string& name, unsigned threads, std::size_t ops, const std::function<void(std::size_t)>& body)
+{
+    auto scope = name + " x" + std::to_string(threads);
+    auto ns = bench::measureNs(3, [&]() {
+        std::vector<std::thread> workers;
+        for(unsigned t = 0; t < threads; ++t)
+            workers.emplace_back([&]() {
+                perf::PerfScope perfScope(scope);
+                body(ops);
+            });
+        for(auto& w : workers)
+            w.join();
+    });
+    return ns / static_cast<double>(ops);
+}
+
+
+// a connection with a 16KB buffer and a header table set up in the constructor
+struct Connection
+{
+    Connection()
+    {
+        std::memset(buffer, 0, sizeof(buffer));
+        for(int i = 0; i < 64; ++i)
+            headers[i] = i;
+    }
+    int fd = -1;
+    int headers[64];
+    char buffer[16 * 1024];
+};
+
+void objectCacheBenchmark(std::size_t ops)
+{
+    auto newDelete = bench::measureNs(3, [&]() {
+        for(std::size_t i = 0; i < ops; ++i)
+        {
+            auto connection = new Connection();
+            connection->fd = static_cast<int>(i);
+            bench::doNotOptimize(connection->buffer[0]);
+            delete connection;
+        }
+    });
+    zeroalloc::ObjectCache<Connection> cache;
+    auto cached = bench::measureNs(3, [&]() {
+        for(std::size_t i = 0; i < ops; ++i)
+        {
+            auto connection = cache.acquire();
+            connection->fd = static_cast<int>(i);      // per use state only
+            bench::doNotOptimize(connection->buffer[0]);
+            cache.release(connection);
+        }
+    });
+    std::printf("\n%-36s %12s\n", "Connection(16KB), 1 thread", "ns/object");
+    std::printf("%-36s %12.1f\n", "new + delete", newDelete / static_cast<double>(ops));
+    std::printf("%-36s %12.1f\n", "ObjectCache acquire + release", cached / static_cast<double>(ops));
+}
+
+int main(int argc, char** argv)
+{
+    std::size_t ops = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 4 * 1024 * 1024;
+    unsigned maxThreads = argc > 2 ? static_cast<unsigned>(std::atoi(argv[2])) : std::max(1u, std::thread::hardware_concurrency());
+    auto sizes = mixedSizes();
+
+    std::pmr::synchronized_pool_resource synchronizedPool;
+    struct Row
+    {
+        const char* name;
+        std::function<void(std::size_t)> body;
+    };
+    std::vector<Row> rows = {
+        {"malloc", [&](std::size_t n) { workload(*std::pmr::new_delete_resource(), n, sizes, []() {}); }},
+        {"pmr::synchronized_pool_resource", [&](std::size_t n) { workload(synchronizedPool, n, sizes, []() {}); }},
+        {"pmr::monotonic_buffer_resource", [&](std::size_t n) {
+             char buffer[64 * 1024];
+             std::pmr::monotonic_buffer_resource monotonic(buffer, sizeof(buffer));
+             workload(monotonic, n, sizes, [&]() { monotonic.release(); });
+         }},
+        {"RequestArena", [&](std::size_t n) {
+             zeroalloc::RequestArena arena;
+             workload(arena, n, sizes, [&]() { arena.reset(); });
+         }},
+        {"StaticFreeList<1024, 64>", [&](std::size_t n) {
+             auto freeList = std::make_unique<zeroalloc::StaticFreeList<1024, window>>();
+             workload(*freeList, n, sizes, []() {});
+         }},
+        {"PerThreadPool", [&](std::size_t n) { workload(zeroalloc::PerThreadPool::instance(), n, sizes, []() {}); }},
+    };
+
+    std::printf("%-36s", "ns per allocate+free / threads");
+    for(unsigned threads = 1; threads <= maxThreads; ++threads)
+        std::printf(" %8u", threads);
+    std::printf("\n");
+    for(auto& row : rows)
+    {
+        std::printf("%-36s", row.name);
+        for(unsigned threads = 1; threads <= maxThreads; ++threads)
+            std::printf(" %8.1f", run(row.name, threads, ops, row.body));
+        std::printf("\n");
+    }
+
+    objectCacheBenchmark(ops / 16);
+
+    std::printf("\ncounters per thread(PERF_JSON=file writes them as JSON)\n");
+    perf::Report::global().print();
+    return 0;
+}
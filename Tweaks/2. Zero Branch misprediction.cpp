@@ -0,0 +1,242 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "Branchless.hpp"
+#include "../Common/Bench.hpp"
+#include "../Common/Perf.hpp"
+
+/*
+ * every kernel of Branchless.hpp against the branchy code it replaces, sweeping how often the branch is taken
+ * from 0% to 100%. at 0% and 100% the predictor is always right, at 50% it is right half of the time.
+ * values are uniform in [0, 1000), "taken with probability p" is value < 10 * p.
+ * + partition / filter: pred(x) = x < threshold, branchy = std::partition / std::copy_if
+ * + clamp:              p = share of values above the upper bound, branchy = if(x > hi) x = hi
+ * + lower bound:        p = share of random queries, the others repeat the previous one(same path, predicted)
+ * + lookup table:       p = share of digits in a text of digits and letters, branchy = a case range switch
+ * with hardware counters(see Common/Perf.hpp) the branch misses per element are printed next to the times.
+ *
+ * g++ "2. Zero Branch misprediction.cpp" -std=c++20 -O2
+ * ./a.out [n = 1M] [repeat = 5]
+ */
+
+constexpr int percents[] = {0, 1, 2, 5, 10, 20, 30, 40, 50, 60, 70, 80, 90, 95, 98, 99, 100};
+
+// the branchy versions, what you'd write without thinking about it
+namespace branchy
+{
+
+template <class T>
+void clamp(T* data, std::size_t size, T lo, T hi)
+{
+    for(std::size_t i = 0; i < size; ++i)
+    {
+        if(data[i] < lo)
+            data[i] = lo;
+        else if(hi < data[i])
+            data[i] = hi;
+    }
+}
+
+enum Class : std::uint8_t { Digit, Letter, Space, Other };
+
+void tally(const unsigned char* data, std::size_t size, std::uint64_t (&counts)[4])
+{
+    std::uint64_t digits = 0, letters = 0, spaces = 0, others = 0;
+    for(std::size_t i = 0; i < size; ++i)
+    {
+        switch(data[i])
+        {
+        case '0' ... '9': ++digits; break;
+        case 'a' ... 'z':
+        case 'A' ... 'Z': ++letters; break;
+        case ' ':
+        case '\t':
+        case '\n': ++spaces; break;
+        default: ++others; break;
+        }
+        // keeps gcc from turning the switch into adds of compare results(= branchless)
+        asm volatile("");
+    }
+    counts[Digit] += digits;
+    counts[Letter] += letters;
+    counts[Space] += spaces;
+    counts[Other] += others;
+}
+
+} // namespace branchy
+
+// p% of the values below 10 * p
+std::vector<std::uint32_t> values(std::size_t n)
+{
+    std::mt19937 rng(7);
+    std::uniform_int_distribution<std::uint32_t> dist(0, 999);
+    std::vector<std::uint32_t> vec(n);
+    for(auto& v : vec)
+        v = dist(rng);
+    return vec;
+}
+
+struct Point
+{
+    int percent;
+    double branchy;
+    double branchless;
+};
+
+// the perf scope of one measurement: "partition branchy 50%"
+std::string scope(const char* kernel, const char* variant, int percent)
+{
+    return std::string(kernel) + " " + variant + " " + std::to_string(percent) + "%";
+}
+
+// branch misses per element of a scope, "-" without a PMU
+std::string misses(const std::string& scope, std::size_t n)
+{
+    auto sample = perf::Report::global().find(scope);
+    if(sample.runs == 0 || !sample.available[perf::BranchMisses])
+        return "-";
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%.3f", static_cast<double>(sample.count[perf::BranchMisses]) / sample.runs / n);
+    return buf;
+}
+
+void print(const char* title, const char* kernel, const char* variant, std::size_t n, const std::vector<Point>& points)
+{
+    std::printf("\n%s\n%8s %14s %14s %14s %14s\n", title, "taken %", "branchy ns", "branchless ns", "branchy miss",
+                "branchless miss");
+    for(auto& point : points)
+        std::printf("%8d %14.2f %14.2f %14s %14s%s\n", point.percent, point.branchy, point.branchless,
+                    misses(scope(kernel, "branchy", point.percent), n).c_str(),
+                    misses(scope(kernel, variant, point.percent), n).c_str(),
+                    point.branchless < point.branchy ? "   <- branchless" : "");
+    // the ranges of p where the branchless kernel wins
+    std::printf("branchless wins:");
+    bool any = false;
+    for(std::size_t i = 0; i < points.size(); ++i)
+    {
+        if(points[i].branchless >= points[i].branchy || (i > 0 && points[i - 1].branchless < points[i - 1].branchy))
+            continue;
+        auto j = i;
+        while(j + 1 < points.size() && points[j + 1].branchless < points[j + 1].branchy)
+            ++j;
+        std::printf(" [%d%%, %d%%]", points[i].percent, points[j].percent);
+        any = true;
+    }
+    std::printf("%s\n", any ? "" : " never");
+}
+
+int main(int argc, char** argv)
+{
+    std::size_t n = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1 << 20;
+    int repeat = argc > 2 ? std::atoi(argv[2]) : 5;
+    auto input = values(n);
+    std::vector<std::uint32_t> work(n), out(n);
+    auto perElement = [&](double ns) { return ns / static_cast<double>(n); };
+
+    std::vector<Point> points;
+    for(int p : percents)
+    {
+        std::uint32_t threshold = 10 * p;
+        auto pred = [threshold](std::uint32_t x) { return x < threshold; };
+        auto reset = [&]() { work = input; };
+        auto a = perf::measureNs(scope("partition", "branchy", p), repeat, reset, [&]() { bench::doNotOptimize(std::partition(work.begin(), work.end(), pred)); });
+        auto b = perf::measureNs(scope("partition", "branchless", p), repeat, reset, [&]() { bench::doNotOptimize(branchless::partition(work.begin(), work.end(), pred)); });
+        if(!std::is_partitioned(work.begin(), work.end(), pred))
+            std::abort();
+        points.push_back({p, perElement(a), perElement(b)});
+    }
+    print("partition", "partition", "branchless", n, points);
+
+    points.clear();
+    for(int p : percents)
+    {
+        std::uint32_t threshold = 10 * p;
+        auto pred = [threshold](std::uint32_t x) { return x < threshold; };
+        std::uint32_t *endA = nullptr, *endB = nullptr;
+        auto a = perf::measureNs(scope("filter", "branchy", p), repeat, [&]() { bench::doNotOptimize(endA = std::copy_if(input.begin(), input.end(), out.data(), pred)); });
+        auto b = perf::measureNs(scope("filter", "branchless", p), repeat, [&]() { bench::doNotOptimize(endB = branchless::filter(input.begin(), input.end(), out.data(), pred)); });
+        if(endA != endB)
+            std::abort();
+        points.push_back({p, perElement(a), perElement(b)});
+    }
+    print("filter", "filter", "branchless", n, points);
+
+    points.clear();
+    for(int p : percents)
+    {
+        std::uint32_t hi = 1000 - 10 * p;      // p% of the values are above
+        auto reset = [&]() { work = input; };
+        auto a = perf::measureNs(scope("clamp", "branchy", p), repeat, reset, [&]() { branchy::clamp(work.data(), n, 0u, hi); bench::clobberMemory(); });
+        auto b = perf::measureNs(scope("clamp", "branchless", p), repeat, reset, [&]() { branchless::clamp(work.data(), n, 0u, hi); bench::clobberMemory(); });
+        points.push_back({p, perElement(a), perElement(b)});
+    }
+    print("clamp", "clamp", "branchless", n, points);
+
+    {
+        std::vector<std::uint32_t> sorted(n);
+        for(std::size_t i = 0; i < n; ++i)
+            sorted[i] = static_cast<std::uint32_t>(2 * i);
+        branchless::Eytzinger<std::uint32_t> eytzinger(sorted);
+        std::vector<Point> eytzingerPoints;
+        points.clear();
+        std::mt19937 rng(11);
+        std::uniform_int_distribution<std::uint32_t> key(0, static_cast<std::uint32_t>(2 * n));
+        std::uniform_int_distribution<int> percent(0, 99);
+        std::vector<std::uint32_t> queries(n);
+        for(int p : percents)
+        {
+            std::uint32_t last = key(rng);
+            for(auto& q : queries)
+                q = percent(rng) < p ? (last = key(rng)) : last;
+            std::size_t sumA = 0, sumB = 0, sumC = 0;
+            auto a = perf::measureNs(scope("search", "branchy", p), repeat, [&]() {
+                for(auto q : queries)
+                    sumA += static_cast<std::size_t>(std::lower_bound(sorted.begin(), sorted.end(), q) - sorted.begin());
+            });
+            auto b = perf::measureNs(scope("search", "branchless", p), repeat, [&]() {
+                for(auto q : queries)
+                    sumB += branchless::lowerBound(sorted.data(), n, q);
+            });
+            auto c = perf::measureNs(scope("search", "eytzinger", p), repeat, [&]() {
+                for(auto q : queries)
+                    sumC += eytzinger.lowerBound(q);
+            });
+            if(sumA != sumB || sumA != sumC)
+                std::abort();
+            points.push_back({p, perElement(a), perElement(b)});
+            eytzingerPoints.push_back({p, perElement(a), perElement(c)});
+        }
+        print("lower bound(std::lower_bound vs branchless on the sorted array), ns per query", "search", "branchless", n, points);
+        print("lower bound(std::lower_bound vs Eytzinger), ns per query", "search", "eytzinger", n, eytzingerPoints);
+    }
+
+    points.clear();
+    constexpr branchless::LookupTable<branchy::Class> table([](unsigned char c) {
+        if(c >= '0' && c <= '9')
+            return branchy::Digit;
+        if((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'))
+            return branchy::Letter;
+        if(c == ' ' || c == '\t' || c == '\n')
+            return branchy::Space;
+        return branchy::Other;
+    });
+    std::vector<unsigned char> text(n);
+    for(int p : percents)
+    {
+        for(std::size_t i = 0; i < n; ++i)
+            text[i] = input[i] < 10u * p ? static_cast<unsigned char>('0' + input[i] % 10) : static_cast<unsigned char>('a' + input[i] % 26);
+        std::uint64_t countsA[4] = {}, countsB[4] = {};
+        auto a = perf::measureNs(scope("lookup", "branchy", p), repeat, [&]() { branchy::tally(text.data(), n, countsA); });
+        auto b = perf::measureNs(scope("lookup", "branchless", p), repeat, [&]() { branchless::tally(text.data(), n, table, countsB); });
+        if(countsA[branchy::Digit] != countsB[branchy::Digit])
+            std::abort();
+        points.push_back({p, perElement(a), perElement(b)});
+    }
+    print("lookup table classification", "lookup", "branchless", n, points);
+    return 0;
+}
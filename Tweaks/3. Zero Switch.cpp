@@ -1,37 +1,399 @@
-#include <chrono>
-#include <iostream>
-#include <cassert>
 #include <algorithm>
-#include <vector>
+#include <barrier>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <execution>
+#include <functional>
 #include <numeric>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../Common/Bench.hpp"
+#include "../Common/Perf.hpp"
+
+/*
+ * sorting benchmark: std::sort vs std::sort(par_unseq) vs parallel LSD radix sort vs branchless pdq-style sort
+ * over several input distributions, median of `repeat` runs, steady_clock.
+ *
+ * g++ "3. Zero Switch.cpp" -std=c++20 -O2 -pthread -ltbb
+ * ./a.out [n = 64M] [repeat = 5] [threads = hardware_concurrency]
+ */
+
+// ---------------------------------------------------------------- inputs
+
+std::vector<int> sortedInput(std::size_t n, std::mt19937_64&)
+{
+    std::vector<int> vec(n);
+    std::iota(vec.begin(), vec.end(), 0);
+    return vec;
+}
 
-template <class Vec>
-void sort(Vec& vec)
+std::vector<int> reversedInput(std::size_t n, std::mt19937_64& rng)
 {
-    auto start = std::chrono::system_clock::now();
-    std::sort(vec.begin(), vec.end());
-    auto end = std::chrono::system_clock::now();
-    std::cout<<std::chrono::duration_cast<std::chrono::microseconds>(end - start).count()<<std::endl;
+    auto vec = sortedInput(n, rng);
+    std::reverse(vec.begin(), vec.end());
+    return vec;
 }
 
+std::vector<int> shuffledInput(std::size_t n, std::mt19937_64& rng)
+{
+    auto vec = sortedInput(n, rng);
+    std::shuffle(vec.begin(), vec.end(), rng);      // std::random_shuffle is removed in c++17
+    return vec;
+}
 
-int main()
+std::vector<int> fewUniqueInput(std::size_t n, std::mt19937_64& rng)
 {
-    std::vector<int> vec(1024 * 1024 * 64);
-    std::iota(vec.begin(), vec.end(), 0);
+    std::vector<int> vec(n);
+    std::uniform_int_distribution<int> dist(0, 15);
+    for(auto& i : vec)
+        i = dist(rng);
+    return vec;
+}
+
+// 16 ascending runs
+std::vector<int> sawtoothInput(std::size_t n, std::mt19937_64&)
+{
+    std::vector<int> vec(n);
+    auto period = std::max<std::size_t>(n / 16, 1);
+    for(std::size_t i = 0; i < n; ++i)
+        vec[i] = static_cast<int>(i % period);
+    return vec;
+}
 
-    auto v1 = vec;
-    auto v2 = vec;
+// zipf(s = 1) over 1M distinct keys, sampled through the inverse cdf
+std::vector<int> zipfInput(std::size_t n, std::mt19937_64& rng)
+{
+    constexpr std::size_t distinct = 1 << 20;
+    std::vector<double> cdf(distinct);
+    double sum = 0;
+    for(std::size_t k = 0; k < distinct; ++k)
+        cdf[k] = (sum += 1.0 / static_cast<double>(k + 1));
+    for(auto& c : cdf)
+        c /= sum;
+
+    std::vector<int> vec(n);
+    std::uniform_real_distribution<double> dist(0.0, 1.0);
+    for(auto& i : vec)
+        i = static_cast<int>(std::lower_bound(cdf.begin(), cdf.end(), dist(rng)) - cdf.begin());
+    return vec;
+}
+
+// ---------------------------------------------------------------- parallel LSD radix sort
+
+// 4 passes of 8 bits, the sign bit is flipped so that the keys order as unsigned.
+// every pass: each thread counts its chunk, one thread turns the (digit, thread) counts into offsets,
+// each thread scatters its chunk. passes where every key has the same digit are skipped.
+void radixSort(std::vector<int>& vec, unsigned threads)
+{
+    constexpr int radix = 256;
+    const std::size_t n = vec.size();
+    if(n < 2)
+        return;
+    threads = std::max(1u, std::min<unsigned>(threads, static_cast<unsigned>(n / 4096 + 1)));
+
+    std::vector<std::uint32_t> a(n), b(n);
+    std::vector<std::size_t> counts(threads * radix);
+    bool skip = false;
+    auto* src = a.data();
+
+    std::barrier sync(threads, [&]() noexcept {
+        // counts[t * radix + d] -> start offset of thread t's digit d
+        std::size_t offset = 0;
+        std::size_t nonEmpty = 0;
+        for(int d = 0; d < radix; ++d)
+        {
+            std::size_t digitTotal = 0;
+            for(unsigned t = 0; t < threads; ++t)
+            {
+                auto c = counts[t * radix + d];
+                counts[t * radix + d] = offset;
+                offset += c;
+                digitTotal += c;
+            }
+            nonEmpty += digitTotal != 0;
+        }
+        skip = nonEmpty == 1;
+    });
 
-    std::reverse(v1.begin(), v1.end());
-    std::random_shuffle(v2.begin(), v2.end());
+    auto worker = [&](unsigned t) {
+        const std::size_t lo = n * t / threads;
+        const std::size_t hi = n * (t + 1) / threads;
+        for(std::size_t i = lo; i < hi; ++i)
+            a[i] = static_cast<std::uint32_t>(vec[i]) ^ 0x80000000u;
 
-    sort(vec);
-    sort(v1);
-    sort(v2);
+        auto* in = a.data();
+        auto* out = b.data();
+        for(int shift = 0; shift < 32; shift += 8)
+        {
+            auto* cnt = &counts[t * radix];
+            std::fill(cnt, cnt + radix, 0);
+            for(std::size_t i = lo; i < hi; ++i)
+                ++cnt[(in[i] >> shift) & 0xff];
+            sync.arrive_and_wait();     // completion step computes the offsets
+            if(!skip)
+            {
+                for(std::size_t i = lo; i < hi; ++i)
+                    out[cnt[(in[i] >> shift) & 0xff]++] = in[i];
+                std::swap(in, out);
+            }
+            sync.arrive_and_wait();     // everyone finished scattering before the counts are reused
+        }
+        if(t == 0)
+            src = in;
+    };
 
-    assert(is_sorted(vec.begin(), vec.end()));
-    assert(is_sorted(v1.begin(), v1.end()));
-    assert(is_sorted(v2.begin(), v2.end()));
+    std::vector<std::thread> pool;
+    for(unsigned t = 1; t < threads; ++t)
+        pool.emplace_back(worker, t);
+    worker(0);
+    for(auto& th : pool)
+        th.join();
+
+    for(std::size_t i = 0; i < n; ++i)
+        vec[i] = static_cast<int>(src[i] ^ 0x80000000u);
+}
+
+// ---------------------------------------------------------------- branchless pdq-style sort
+
+namespace pdq
+{
+constexpr std::ptrdiff_t insertionThreshold = 24;
+constexpr std::ptrdiff_t nintherThreshold = 128;
+constexpr std::ptrdiff_t blockSize = 64;
+
+template <class T>
+void insertionSort(T* begin, T* end)
+{
+    for(auto cur = begin + 1; cur < end; ++cur)
+    {
+        auto tmp = *cur;
+        auto sift = cur;
+        for(; sift != begin && tmp < sift[-1]; --sift)
+            *sift = sift[-1];
+        *sift = tmp;
+    }
+}
+
+template <class T>
+void sort3(T* a, T* b, T* c)
+{
+    if(*b < *a) std::iter_swap(a, b);
+    if(*c < *b) std::iter_swap(b, c);
+    if(*b < *a) std::iter_swap(a, b);
+}
+
+// BlockQuicksort partition: the comparisons only write offsets into small buffers,
+// the swaps happen afterwards, so the loop has no data dependent branch.
+// pivot is *begin, returns the final pivot position.
+template <class T>
+T* partitionBranchless(T* begin, T* end)
+{
+    const T pivot = *begin;
+    T* first = begin + 1;
+    T* last = end;
+    unsigned char offsetsL[blockSize];
+    unsigned char offsetsR[blockSize];
+    std::ptrdiff_t numL = 0, numR = 0, startL = 0, startR = 0;
+
+    while(last - first > 2 * blockSize)
+    {
+        if(numL == 0)
+        {
+            startL = 0;
+            for(std::ptrdiff_t i = 0; i < blockSize; ++i)
+            {
+                offsetsL[numL] = static_cast<unsigned char>(i);
+                numL += !(first[i] < pivot);
+            }
+        }
+        if(numR == 0)
+        {
+            startR = 0;
+            for(std::ptrdiff_t i = 0; i < blockSize; ++i)
+            {
+                offsetsR[numR] = static_cast<unsigned char>(i);
+                numR += last[-1 - i] < pivot;
+            }
+        }
+        auto num = std::min(numL, numR);
+        for(std::ptrdiff_t i = 0; i < num; ++i)
+            std::iter_swap(first + offsetsL[startL + i], last - 1 - offsetsR[startR + i]);
+        numL -= num; numR -= num;
+        startL += num; startR += num;
+        if(numL == 0) first += blockSize;
+        if(numR == 0) last -= blockSize;
+    }
+    // everything left of `first` is < pivot, everything from `last` on is >= pivot,
+    // the pending offsets are only a cache, finish the rest with a plain partition
+    auto mid = std::partition(first, last, [&](const T& x) { return x < pivot; });
+    std::iter_swap(begin, mid - 1);
+    return mid - 1;
+}
+
+template <class T>
+void heapSort(T* begin, T* end)
+{
+    std::make_heap(begin, end);
+    std::sort_heap(begin, end);
+}
+
+template <class T>
+void sortLoop(T* begin, T* end, int badAllowed, bool leftmost)
+{
+    while(true)
+    {
+        auto size = end - begin;
+        if(size < insertionThreshold)
+        {
+            insertionSort(begin, end);
+            return;
+        }
+
+        auto half = size / 2;
+        if(size > nintherThreshold)
+        {
+            sort3(begin, begin + half, end - 1);
+            sort3(begin + 1, begin + (half - 1), end - 2);
+            sort3(begin + 2, begin + (half + 1), end - 3);
+            sort3(begin + (half - 1), begin + half, begin + (half + 1));
+        }
+        else
+            sort3(begin + half, begin, end - 1);
+        std::iter_swap(begin, begin + half);
+
+        // begin[-1] <= every element here, if it equals the pivot then the pivot is the minimum:
+        // put all keys equal to it on the left and only continue on the right (few unique keys)
+        if(!leftmost && !(begin[-1] < *begin))
+        {
+            const T pivot = *begin;
+            begin = std::partition(begin, end, [&](const T& x) { return !(pivot < x); });
+            continue;
+        }
+
+        auto pivotPos = partitionBranchless(begin, end);
+        auto sizeL = pivotPos - begin;
+        auto sizeR = end - (pivotPos + 1);
+        if(sizeL < size / 8 || sizeR < size / 8)
+        {
+            if(--badAllowed == 0)
+            {
+                heapSort(begin, end);
+                return;
+            }
+            // break up patterns that keep producing bad pivots
+            if(sizeL >= insertionThreshold)
+            {
+                std::iter_swap(begin, begin + sizeL / 4);
+                std::iter_swap(pivotPos - 1, pivotPos - sizeL / 4);
+            }
+            if(sizeR >= insertionThreshold)
+            {
+                std::iter_swap(pivotPos + 1, pivotPos + 1 + sizeR / 4);
+                std::iter_swap(end - 1, end - sizeR / 4);
+            }
+        }
+
+        // recurse into the smaller side, loop on the larger one
+        if(sizeL < sizeR)
+        {
+            sortLoop(begin, pivotPos, badAllowed, leftmost);
+            begin = pivotPos + 1;
+            leftmost = false;
+        }
+        else
+        {
+            sortLoop(pivotPos + 1, end, badAllowed, false);
+            end = pivotPos;
+        }
+    }
+}
+
+template <class T>
+void sort(T* begin, T* end)
+{
+    if(end - begin < 2)
+        return;
+    int log2 = 0;
+    for(auto n = end - begin; n > 1; n >>= 1)
+        ++log2;
+    sortLoop(begin, end, log2, true);
+}
+} // namespace pdq
+
+// ---------------------------------------------------------------- harness
+
+struct Input
+{
+    const char* name;
+    std::vector<int> (*make)(std::size_t, std::mt19937_64&);
+};
+
+struct Engine
+{
+    const char* name;
+    std::function<void(std::vector<int>&)> sort;
+    bool otherThreads;      // the sort also runs on threads the counters of the scope don't see
+};
+
+int main(int argc, char** argv)
+{
+    std::size_t n = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : std::size_t{1024 * 1024 * 64};
+    int repeat = argc > 2 ? std::atoi(argv[2]) : 5;
+    unsigned threads = argc > 3 ? static_cast<unsigned>(std::atoi(argv[3])) : std::thread::hardware_concurrency();
+    if(threads == 0)
+        threads = 1;
+    if(repeat <= 0)
+        repeat = 1;
+
+    const Input inputs[] = {
+        {"sorted", sortedInput},
+        {"reversed", reversedInput},
+        {"shuffled", shuffledInput},
+        {"few-unique", fewUniqueInput},
+        {"sawtooth", sawtoothInput},
+        {"zipf", zipfInput},
+    };
+    const Engine engines[] = {
+        {"std::sort", [](std::vector<int>& v) { std::sort(v.begin(), v.end()); }, false},
+        {"std::sort(par_unseq)", [](std::vector<int>& v) { std::sort(std::execution::par_unseq, v.begin(), v.end()); },
+         true},
+        {"radix(lsd)", [threads](std::vector<int>& v) { radixSort(v, threads); }, threads > 1},
+        {"pdq(branchless)", [](std::vector<int>& v) { pdq::sort(v.data(), v.data() + v.size()); }, false},
+    };
+
+    std::printf("n = %zu, repeat = %d, threads = %u\n", n, repeat, threads);
+    std::printf("%-12s %-22s %12s %10s %10s\n", "input", "engine", "median(ms)", "ns/key", "GB/s");
+    std::mt19937_64 rng(42);
+    for(const auto& input : inputs)
+    {
+        const auto original = input.make(n, rng);
+        auto expected = original;
+        std::sort(expected.begin(), expected.end());
+
+        std::vector<int> work;
+        for(const auto& engine : engines)
+        {
+            const auto scopeName = std::string(input.name) + " " + engine.name;
+            auto ns = bench::measureNs(repeat, [&]() { work = original; }, [&]() {
+                perf::PerfScope scope(scopeName, engine.otherThreads);
+                engine.sort(work);
+            });
+            if(work != expected)
+            {
+                std::printf("%s produced a wrong result on %s\n", engine.name, input.name);
+                return 1;
+            }
+            std::printf("%-12s %-22s %12.2f %10.2f %10.2f\n", input.name, engine.name, ns / 1e6,
+                        ns / static_cast<double>(n), static_cast<double>(n * sizeof(int)) / ns);
+        }
+    }
+    // par_unseq and radix sort on other threads too, their counters are only the calling thread's share
+    std::printf("\ncounters per sort(PERF_JSON=file writes them as JSON)\n");
+    perf::Report::global().print();
     return 0;
-}
\ No newline at end of file
+}
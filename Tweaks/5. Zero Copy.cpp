@@ -0,0 +1,158 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <string>
+#include <thread>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "ZeroCopy.hpp"
+#include "../Common/Bench.hpp"
+#include "../Common/Perf.hpp"
+
+/*
+ * file -> sink throughput of zerocopy::transfer() for every method, against the naive read()/write() loop.
+ * the file sits in the page cache(written and read once before measuring), so disks don't matter: what is
+ * left is the copying between kernel and user space and the syscalls around it.
+ * sinks:
+ * + pipe:       a consumer thread splices everything on to /dev/null(like a `| consumer` process)
+ * + socketpair: AF_UNIX stream, the consumer read()s into a buffer(sockets can't be spliced from on every kernel)
+ * every transfer() is a perf scope on the sending thread(the consumer runs on its own thread, so the counters
+ * are marked calling thread only), PERF_JSON=<file> writes them as JSON.
+ *
+ * g++ "5. Zero Copy.cpp" -std=c++20 -O2 -pthread
+ * ./a.out [file size in MB = 256] [repeat = 5]
+ */
+
+// the other end of the sink, returns the number of bytes it saw
+std::size_t consume(int fd)
+{
+    std::size_t total = 0;
+    int devnull = ::open("/dev/null", O_WRONLY);
+    // pipes: move the pages on without looking at them
+    while(devnull >= 0)
+    {
+        auto n = ::splice(fd, nullptr, devnull, nullptr, 1 << 20, SPLICE_F_MOVE);
+        if(n < 0 && errno == EINTR)
+            continue;
+        if(n < 0)
+            break;      // not a pipe
+        if(n == 0)
+        {
+            ::close(devnull);
+            return total;
+        }
+        total += static_cast<std::size_t>(n);
+    }
+    if(devnull >= 0)
+        ::close(devnull);
+    auto buffer = std::make_unique<char[]>(1 << 20);
+    while(true)
+    {
+        auto n = ::read(fd, buffer.get(), 1 << 20);
+        if(n < 0 && errno == EINTR)
+            continue;
+        if(n <= 0)
+            return total;
+        total += static_cast<std::size_t>(n);
+    }
+}
+
+// a fresh sink per run: the consumer sees EOF when we close our end
+bool makeSink(bool socket, int fds[2])
+{
+    if(socket)
+        return ::socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) == 0;
+    if(::pipe2(fds, O_CLOEXEC) != 0)
+        return false;
+    ::fcntl(fds[1], F_SETPIPE_SZ, 1 << 20);
+    std::swap(fds[0], fds[1]);      // fds[0] is always the end we write to
+    return true;
+}
+
+bool createFile(const char* path, std::size_t size)
+{
+    int fd = ::open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if(fd < 0)
+        return false;
+    std::string block(1 << 20, '\0');
+    for(std::size_t i = 0; i < block.size(); ++i)
+        block[i] = static_cast<char>('a' + i % 26);
+    bool ok = true;
+    for(std::size_t written = 0; ok && written < size; written += block.size())
+        ok = ::write(fd, block.data(), std::min(block.size(), size - written)) > 0;
+    ::close(fd);
+    return ok;
+}
+
+int main(int argc, char** argv)
+{
+    std::size_t size = (argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 256) << 20;
+    int repeat = argc > 2 ? std::atoi(argv[2]) : 5;
+    char path[] = "/tmp/zerocopyXXXXXX";
+    int tmp = ::mkstemp(path);
+    if(tmp < 0 || !createFile(path, size))
+    {
+        std::perror("temp file");
+        return 1;
+    }
+    ::close(tmp);
+    int in = ::open(path, O_RDONLY | O_CLOEXEC);
+    ::unlink(path);
+    if(in < 0)
+        return 1;
+
+    std::printf("%-12s %-12s %10s %10s\n", "sink", "method", "GB/s", "used");
+    for(bool socket : {false, true})
+    {
+        for(auto method : {zerocopy::Method::Sendfile, zerocopy::Method::Splice, zerocopy::Method::Mmap,
+                           zerocopy::Method::ReadWrite})
+        {
+            const auto scopeName = std::string(socket ? "socketpair " : "pipe ") + zerocopy::name(method);
+            zerocopy::Result result;
+            std::size_t received = 0;
+            bool measuring = false;
+            bool failed = false;
+            auto run = [&]() {
+                int fds[2];
+                if(!makeSink(socket, fds))
+                {
+                    failed = true;
+                    return;
+                }
+                std::thread consumer([&, fd = fds[1]]() { received = consume(fd); });
+                ::lseek(in, 0, SEEK_SET);
+                {
+                    std::optional<perf::PerfScope> scope;
+                    if(measuring)
+                        scope.emplace(scopeName, true);
+                    result = zerocopy::transfer(in, fds[0], method);
+                }
+                ::close(fds[0]);
+                consumer.join();
+                ::close(fds[1]);
+                failed |= result.error != 0 || result.bytes != size || received != size;
+            };
+            run();      // warm the page cache and the pipe buffers
+            measuring = true;
+            auto ns = bench::measureNs(repeat, run);
+            if(failed)
+                std::printf("%-12s %-12s %10s %10s (%s)\n", socket ? "socketpair" : "pipe", zerocopy::name(method), "-",
+                            zerocopy::name(result.method), std::strerror(result.error));
+            else
+                std::printf("%-12s %-12s %10.2f %10s\n", socket ? "socketpair" : "pipe", zerocopy::name(method),
+                            static_cast<double>(size) / ns, zerocopy::name(result.method));
+        }
+    }
+    ::close(in);
+    std::printf("\ncounters per transfer, sending thread(PERF_JSON=file writes them as JSON)\n");
+    perf::Report::global().print();
+    return 0;
+}
@@ -0,0 +1,123 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+#include "EventLoop.hpp"
+#include "../Common/Bench.hpp"
+#include "../Common/Perf.hpp"
+
+/*
+ * the I/O loop wakeup of "6. Zero Syscall.md": 1..64 producer threads post tasks to one io::EventLoop, in
+ * bursts(a request comes in, a few tasks go to the loop) with a short sleep in between, so the loop goes to
+ * sleep and has to be woken again and again.
+ * + eventfd write per post: every post() writes the eventfd
+ * + coalesced:              only the first post after the loop went to sleep writes it
+ * printed: eventfd writes per task, the latency from post() to the task running on the loop(p50/p99), and the
+ * wall time per task. perf scopes: the loop thread("... loop", its context switches are the times it went to sleep
+ * and was woken) and every producer("... producer", averaged over the producers, the eventfd writes are
+ * theirs); PERF_JSON=<file> writes them as JSON.
+ *
+ * g++ "6. Zero Syscall.cpp" -std=c++20 -O2 -pthread
+ * ./a.out [tasks = 64K] [burst = 8] [pause us = 50]
+ */
+
+struct Result
+{
+    double writesPerTask;
+    double p50Us;
+    double p99Us;
+    double wallNsPerTask;
+};
+
+Result run(bool coalesce, unsigned producers, std::size_t tasks, std::size_t burst, std::chrono::microseconds pause)
+{
+    io::EventLoop loop(coalesce);
+    std::vector<double> latencies;          // loop thread only
+    latencies.reserve(tasks);
+    const auto scope = std::string(coalesce ? "coalesced" : "write per post") + " x" + std::to_string(producers);
+    std::thread loopThread([&]() {
+        perf::PerfScope perfScope(scope + " loop");
+        loop.run();
+    });
+
+    auto perProducer = tasks / producers;
+    auto start = bench::nowNs();
+    std::vector<std::thread> workers;
+    for(unsigned p = 0; p < producers; ++p)
+        workers.emplace_back([&]() {
+            perf::PerfScope perfScope(scope + " producer");
+            for(std::size_t i = 0; i < perProducer; ++i)
+            {
+                auto posted = bench::nowNs();
+                loop.post([posted, &latencies]() { latencies.push_back(static_cast<double>(bench::nowNs() - posted)); });
+                if((i + 1) % burst == 0)
+                    std::this_thread::sleep_for(pause);
+            }
+        });
+    for(auto& w : workers)
+        w.join();
+    loop.stop();
+    loopThread.join();
+    auto wall = bench::nowNs() - start;
+
+    auto count = static_cast<double>(perProducer * producers);
+    if(latencies.size() != perProducer * producers)
+        std::abort();
+    std::sort(latencies.begin(), latencies.end());
+    return {static_cast<double>(loop.wakeWrites() - 1) / count,        // - the write of stop()
+            bench::percentile(latencies, 0.5) / 1e3, bench::percentile(latencies, 0.99) / 1e3,
+            static_cast<double>(wall) / count};
+}
+
+// a handler that unwatches its own fd keeps running on its own captures(the loop calls a copy)
+void selfUnwatchCheck()
+{
+    int fds[2];
+    if(::pipe(fds) != 0)
+        std::abort();
+    io::EventLoop loop;
+    std::string seen;
+    std::string tag(64, 'x');           // too big for the small buffer of std::function, lives on the heap
+    loop.watch(fds[0], EPOLLIN, [&, tag](std::uint32_t) {
+        loop.unwatch(fds[0]);
+        seen = tag;
+        loop.stop();
+    });
+    char c = 1;
+    if(::write(fds[1], &c, 1) != 1)
+        std::abort();
+    loop.run();
+    ::close(fds[0]);
+    ::close(fds[1]);
+    if(seen != tag)
+        std::abort();
+}
+
+int main(int argc, char** argv)
+{
+    selfUnwatchCheck();
+
+    std::size_t tasks = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 64 * 1024;
+    std::size_t burst = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 8;
+    std::chrono::microseconds pause(argc > 3 ? std::atoi(argv[3]) : 50);
+
+    std::printf("%-26s %9s %14s %10s %10s %12s\n", "wakeup", "producers", "writes/task", "p50(us)", "p99(us)",
+                "wall ns/task");
+    for(bool coalesce : {false, true})
+        for(unsigned producers = 1; producers <= 64; producers *= 2)
+        {
+            auto r = run(coalesce, producers, tasks, burst, pause);
+            std::printf("%-26s %9u %14.3f %10.1f %10.1f %12.0f\n", coalesce ? "coalesced" : "eventfd write per post",
+                        producers, r.writesPerTask, r.p50Us, r.p99Us, r.wallNsPerTask);
+        }
+    std::printf("\ncounters per thread(PERF_JSON=file writes them as JSON)\n");
+    perf::Report::global().print();
+    return 0;
+}
@@ -0,0 +1,159 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+/*
+ * branchless kernels, header only. the data decides *what* is computed(an index, a step, a select), never
+ * *where* the code jumps, so an unpredictable predicate costs the same as a predictable one: no misprediction,
+ * but also no skipping work. whether that wins depends on how predictable the branch would have been, see
+ * "2. Zero Branch misprediction.md" for the measured crossover points.
+ * + partition: unstable, pred(x) true first
+ * + filter:    copy_if / in place compaction
+ * + clamp:     min/max clamp of every element(vectorizes)
+ * + lowerBound on a sorted array, Eytzinger: lower bound on a cache friendly breadth first layout
+ * + LookupTable: classification by one load instead of a chain of compares
+ */
+namespace branchless
+{
+
+// every element is swapped, only the step of the boundary depends on pred
+template <std::random_access_iterator It, class Pred>
+It partition(It first, It last, Pred pred)
+{
+    auto mid = first;
+    for(; first != last; ++first)
+    {
+        auto value = std::move(*first);
+        bool keep = pred(value);
+        *first = std::move(*mid);
+        *mid = std::move(value);
+        mid += keep;
+    }
+    return mid;
+}
+
+// out needs room for every input element(it is written for each of them), out == first compacts in place
+template <std::input_iterator It, std::random_access_iterator Out, class Pred>
+Out filter(It first, It last, Out out, Pred pred)
+{
+    for(; first != last; ++first)
+    {
+        *out = *first;
+        out += static_cast<bool>(pred(*out));
+    }
+    return out;
+}
+
+template <class T>
+void clamp(T* data, std::size_t size, T lo, T hi)
+{
+    for(std::size_t i = 0; i < size; ++i)
+    {
+        auto value = data[i];
+        value = value < lo ? lo : value;
+        value = hi < value ? hi : value;
+        data[i] = value;
+    }
+}
+
+// index of the first element >= x: the halving step is a select(cmov), the loop count only depends on size
+template <class T>
+std::size_t lowerBound(const T* data, std::size_t size, const T& x)
+{
+    if(size == 0)
+        return 0;
+    const T* base = data;
+    while(size > 1)
+    {
+        auto half = size / 2;
+        base = base[half] < x ? base + half : base;
+        size -= half;
+    }
+    return static_cast<std::size_t>(base - data) + (*base < x);
+}
+
+/*
+ * the sorted values in breadth first(heap) order: the children of node k are 2k and 2k+1, so the first levels
+ * share a few cache lines and the next levels can be prefetched, 16 nodes(of an int) ahead is 4 levels down.
+ * lowerBound returns the index into the original sorted vector, size() if every value is < x.
+ */
+template <class T>
+class Eytzinger
+{
+public:
+    explicit Eytzinger(const std::vector<T>& sorted) : tree(sorted.size() + 1), rank(sorted.size() + 1)
+    {
+        std::size_t next = 0;
+        build(sorted, next, 1);
+        rank[0] = sorted.size();        // the "no such element" node
+    }
+    std::size_t lowerBound(const T& x) const
+    {
+        std::size_t k = 1;
+        while(k < tree.size())
+        {
+            __builtin_prefetch(tree.data() + k * 16);       // only a hint, a prefetch past the end can't fault
+            k = 2 * k + (tree[k] < x);
+        }
+        // the path went right(value < x) after the answer, undo those steps and the last left one
+        k >>= __builtin_ffsll(static_cast<long long>(~k));
+        return rank[k];
+    }
+    std::size_t size() const { return tree.size() - 1; }
+private:
+    void build(const std::vector<T>& sorted, std::size_t& next, std::size_t k)
+    {
+        if(k >= tree.size())
+            return;
+        build(sorted, next, 2 * k);
+        rank[k] = next;
+        tree[k] = sorted[next++];
+        build(sorted, next, 2 * k + 1);
+    }
+    std::vector<T> tree;                // 1 based, tree[0] unused
+    std::vector<std::size_t> rank;
+};
+
+// one load instead of if(c >= '0' && c <= '9') ... else if ...: the class of every byte value precomputed
+template <class Class>
+class LookupTable
+{
+public:
+    template <class F>
+    constexpr explicit LookupTable(F classify)
+    {
+        for(std::size_t c = 0; c < table.size(); ++c)
+            table[c] = classify(static_cast<unsigned char>(c));
+    }
+    constexpr Class operator[](unsigned char c) const { return table[c]; }
+private:
+    std::array<Class, 256> table{};
+};
+
+/*
+ * counts[table[c]] += 1 for every byte. a run of bytes of one class would increment the same counter back
+ * to back, every increment waiting for the store of the previous one: four lanes of counters break that chain.
+ */
+template <std::size_t Classes, class Class, class Count>
+void tally(const unsigned char* data, std::size_t size, const LookupTable<Class>& table, Count (&counts)[Classes])
+{
+    Count lanes[4][Classes] = {};
+    std::size_t i = 0;
+    for(; i + 4 <= size; i += 4)
+    {
+        ++lanes[0][static_cast<std::size_t>(table[data[i]])];
+        ++lanes[1][static_cast<std::size_t>(table[data[i + 1]])];
+        ++lanes[2][static_cast<std::size_t>(table[data[i + 2]])];
+        ++lanes[3][static_cast<std::size_t>(table[data[i + 3]])];
+    }
+    for(; i < size; ++i)
+        ++lanes[0][static_cast<std::size_t>(table[data[i]])];
+    for(std::size_t c = 0; c < Classes; ++c)
+        counts[c] += lanes[0][c] + lanes[1][c] + lanes[2][c] + lanes[3][c];
+}
+
+} // namespace branchless
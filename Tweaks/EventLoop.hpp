@@ -0,0 +1,188 @@
+#pragma once
+
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+/*
+ * single threaded epoll loop, header only, linux.
+ *
+ *     io::EventLoop loop;
+ *     std::thread t([&]() { loop.run(); });
+ *     loop.post([]() { ... });            // from any thread, runs on the loop thread
+ *     loop.stop();
+ *     t.join();
+ *
+ * + watch(fd, events, handler)/unwatch(fd): fd readiness handlers, call them on the loop thread(or before run()),
+ *   a handler may unwatch its own fd
+ * + post(task): the task joins a mutex protected queue, the loop swaps the whole queue out and runs it
+ * + coalesced wakeup(see "6. Zero Syscall.md"): the sleeping loop is woken by an eventfd write, but only the
+ *   first producer after the loop went to sleep writes it. `awake` is true from the moment somebody decided
+ *   to wake the loop until the loop is about to sleep again, so N posts in between cost 0 syscalls, not N.
+ *   EventLoop(false) writes the eventfd on every post, to compare.
+ */
+namespace io
+{
+
+class EventLoop
+{
+public:
+    explicit EventLoop(bool _coalesceWakeups = true) : coalesce(_coalesceWakeups)
+    {
+        epollFd = ::epoll_create1(EPOLL_CLOEXEC);
+        wakeFd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if(epollFd < 0 || wakeFd < 0)
+        {
+            closeFds();
+            throw std::runtime_error("EventLoop: epoll_create1/eventfd failed");
+        }
+        try
+        {
+            watch(wakeFd, EPOLLIN, [this](std::uint32_t) { drainWakeFd(); });
+        }
+        catch(...)
+        {
+            closeFds();         // the destructor doesn't run for a throwing constructor
+            throw;
+        }
+    }
+    EventLoop(const EventLoop&) = delete;
+    EventLoop& operator=(const EventLoop&) = delete;
+    ~EventLoop() { closeFds(); }
+
+    // until stop(), the calling thread becomes the loop thread
+    void run()
+    {
+        loopThread.store(std::this_thread::get_id(), std::memory_order_relaxed);
+        epoll_event events[64];
+        while(!stopping.load(std::memory_order_acquire))
+        {
+            // announce the sleep, then look once more: a post that came before the announcement saw
+            // awake == true and didn't write, its task must be picked up here
+            if(coalesce)
+                awake.store(false, std::memory_order_seq_cst);
+            int timeout = hasPending() ? 0 : -1;
+            if(timeout == 0 && coalesce)
+                awake.store(true, std::memory_order_relaxed);
+            int n = ::epoll_wait(epollFd, events, 64, timeout);
+            if(coalesce)
+                awake.store(true, std::memory_order_relaxed);       // posts from here on don't write
+            if(n < 0 && errno != EINTR)
+                break;
+            for(int i = 0; i < n; ++i)
+            {
+                auto it = handlers.find(events[i].data.fd);
+                if(it == handlers.end())
+                    continue;
+                // a copy: the handler may unwatch(or re-watch) its own fd, which destroys the one in the map
+                auto handler = it->second;
+                handler(events[i].events);
+            }
+            runPending();
+        }
+        runPending();
+        loopThread.store(std::thread::id(), std::memory_order_relaxed);
+    }
+    // any thread
+    void post(std::function<void()> task)
+    {
+        {
+            std::lock_guard<std::mutex> lk(lock);
+            pending.push_back(std::move(task));
+        }
+        posts.fetch_add(1, std::memory_order_relaxed);
+        if(coalesce && (inLoopThread() || awake.exchange(true, std::memory_order_seq_cst)))
+            return;
+        wake();
+    }
+    // any thread, run() returns after the tasks posted so far
+    void stop()
+    {
+        stopping.store(true, std::memory_order_release);
+        wake();
+    }
+
+    // loop thread(or before run()), the handler gets the epoll events(EPOLLIN, EPOLLOUT, ...)
+    void watch(int fd, std::uint32_t events, std::function<void(std::uint32_t)> handler)
+    {
+        epoll_event ev{};
+        ev.events = events;
+        ev.data.fd = fd;
+        auto op = handlers.count(fd) ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+        if(::epoll_ctl(epollFd, op, fd, &ev) != 0)
+            throw std::runtime_error("EventLoop: epoll_ctl failed");
+        handlers[fd] = std::move(handler);
+    }
+    void unwatch(int fd)
+    {
+        if(handlers.erase(fd) != 0)
+            ::epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+    }
+
+    bool inLoopThread() const { return loopThread.load(std::memory_order_relaxed) == std::this_thread::get_id(); }
+    std::size_t postCount() const { return posts.load(std::memory_order_relaxed); }
+    std::size_t wakeWrites() const { return writes.load(std::memory_order_relaxed); }
+private:
+    void wake()
+    {
+        std::uint64_t one = 1;
+        // EAGAIN(counter saturated) still leaves the fd readable
+        while(::write(wakeFd, &one, sizeof(one)) < 0 && errno == EINTR)
+            ;
+        writes.fetch_add(1, std::memory_order_relaxed);
+    }
+    void drainWakeFd()
+    {
+        std::uint64_t count;
+        while(::read(wakeFd, &count, sizeof(count)) < 0 && errno == EINTR)
+            ;
+    }
+    bool hasPending()
+    {
+        std::lock_guard<std::mutex> lk(lock);
+        return !pending.empty();
+    }
+    void runPending()
+    {
+        {
+            std::lock_guard<std::mutex> lk(lock);
+            running.swap(pending);
+        }
+        for(auto& task : running)
+            task();
+        running.clear();        // keeps the capacity, the next swap hands it to producers
+    }
+    void closeFds()
+    {
+        if(wakeFd >= 0)
+            ::close(wakeFd);
+        if(epollFd >= 0)
+            ::close(epollFd);
+    }
+
+    const bool coalesce;
+    int epollFd = -1;
+    int wakeFd = -1;
+    std::unordered_map<int, std::function<void(std::uint32_t)>> handlers;     // loop thread only
+    std::mutex lock;                                                         // guards pending
+    std::vector<std::function<void()>> pending;
+    std::vector<std::function<void()>> running;                              // loop thread only
+    alignas(64) std::atomic<bool> awake{true};
+    std::atomic<bool> stopping{false};
+    std::atomic<std::thread::id> loopThread{};
+    std::atomic<std::size_t> posts{0};
+    std::atomic<std::size_t> writes{0};
+};
+
+} // namespace io
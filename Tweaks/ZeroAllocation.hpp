@@ -0,0 +1,357 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <mutex>
+#include <new>
+#include <vector>
+
+/*
+ * the allocation strategies of "1. ZeroAllocation.md" as std::pmr::memory_resource(s), header only:
+ * + RequestArena:   per request pool(Nginx), bump allocation, free is a no-op, reset() at the end of the request
+ * + StaticFreeList: every block reserved up front, allocation pops a free list(Redis events, Nginx connections)
+ * + ObjectCache:    slab style cache of already constructed objects(Linux slab), not a resource but built on one
+ * + PerThreadPool:  size classes with a free list per thread, a shared central list refilled in batches(tcmalloc)
+ *
+ *     zeroalloc::RequestArena arena;
+ *     std::pmr::vector<int> vec(&arena);     // any pmr container
+ *
+ * RequestArena/StaticFreeList/ObjectCache are not thread safe: one per thread(or per request) is the point.
+ */
+namespace zeroalloc
+{
+
+namespace detail
+{
+
+// align is a power of two(memory_resource requires it)
+inline char* alignUp(char* ptr, std::size_t align)
+{
+    auto value = reinterpret_cast<std::uintptr_t>(ptr);
+    return ptr + (((value + align - 1) & ~(align - 1)) - value);
+}
+
+} // namespace detail
+
+
+// chunks are kept across reset(): after the first few requests a request allocates nothing from upstream
+class RequestArena : public std::pmr::memory_resource
+{
+public:
+    explicit RequestArena(std::size_t _chunkSize = 64 * 1024,
+                          std::pmr::memory_resource* _upstream = std::pmr::get_default_resource())
+        : chunkSize(_chunkSize), upstream(_upstream) {}
+    RequestArena(const RequestArena&) = delete;
+    RequestArena& operator=(const RequestArena&) = delete;
+    ~RequestArena() override
+    {
+        for(auto& chunk : chunks)
+            upstream->deallocate(chunk.data, chunk.size, alignof(std::max_align_t));
+    }
+    // end of the request: everything allocated so far is gone at once
+    void reset()
+    {
+        current = 0;
+        ptr = chunks.empty() ? nullptr : chunks[0].data;
+        end = chunks.empty() ? nullptr : chunks[0].data + chunks[0].size;
+    }
+    std::size_t capacity() const
+    {
+        std::size_t total = 0;
+        for(auto& chunk : chunks)
+            total += chunk.size;
+        return total;
+    }
+private:
+    void* do_allocate(std::size_t bytes, std::size_t align) override
+    {
+        auto p = detail::alignUp(ptr, align);
+        if(ptr == nullptr || bytes > static_cast<std::size_t>(end - p))
+        {
+            nextChunk(bytes + align);
+            p = detail::alignUp(ptr, align);
+        }
+        ptr = p + bytes;
+        return p;
+    }
+    void do_deallocate(void*, std::size_t, std::size_t) override {}
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+
+    // the next kept chunk that fits, a new one at the end otherwise
+    void nextChunk(std::size_t need)
+    {
+        std::size_t next = ptr == nullptr ? 0 : current + 1;
+        while(next < chunks.size() && chunks[next].size < need)
+            ++next;
+        if(next == chunks.size())
+        {
+            auto size = std::max(chunkSize, need);
+            chunks.push_back({static_cast<char*>(upstream->allocate(size, alignof(std::max_align_t))), size});
+        }
+        current = next;
+        ptr = chunks[current].data;
+        end = ptr + chunks[current].size;
+    }
+
+    struct Chunk
+    {
+        char* data;
+        std::size_t size;
+    };
+    std::size_t chunkSize;
+    std::pmr::memory_resource* upstream;
+    std::vector<Chunk> chunks;
+    std::size_t current = 0;
+    char* ptr = nullptr;
+    char* end = nullptr;
+};
+
+
+/*
+ * all Blocks blocks of BlockSize bytes live inside the object, no allocation after construction(put it in static
+ * storage and it's truly static). a request that doesn't fit a block, or comes when all blocks are taken, goes
+ * to upstream: null_memory_resource(the default) throws std::bad_alloc, like a server out of connection slots.
+ */
+template <std::size_t BlockSize, std::size_t Blocks>
+class StaticFreeList : public std::pmr::memory_resource
+{
+    static constexpr std::size_t blockSize = (BlockSize + alignof(std::max_align_t) - 1) / alignof(std::max_align_t) *
+                                             alignof(std::max_align_t);
+public:
+    explicit StaticFreeList(std::pmr::memory_resource* _upstream = std::pmr::null_memory_resource()) : upstream(_upstream)
+    {
+        for(std::size_t i = Blocks; i-- > 0;)
+            push(storage + i * blockSize);
+    }
+    StaticFreeList(const StaticFreeList&) = delete;
+    StaticFreeList& operator=(const StaticFreeList&) = delete;
+    std::size_t available() const { return free; }
+private:
+    void* do_allocate(std::size_t bytes, std::size_t align) override
+    {
+        if(head == nullptr || bytes > blockSize || align > alignof(std::max_align_t))
+            return upstream->allocate(bytes, align);
+        auto node = head;
+        head = node->next;
+        --free;
+        return node;
+    }
+    void do_deallocate(void* p, std::size_t bytes, std::size_t align) override
+    {
+        auto byte = static_cast<std::byte*>(p);
+        if(byte >= storage && byte < storage + sizeof(storage))
+            push(byte);
+        else
+            upstream->deallocate(p, bytes, align);
+    }
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+
+    struct Node
+    {
+        Node* next;
+    };
+    void push(std::byte* block)
+    {
+        head = ::new(block) Node{head};
+        ++free;
+    }
+
+    alignas(std::max_align_t) std::byte storage[blockSize * Blocks];
+    std::pmr::memory_resource* upstream;
+    Node* head = nullptr;
+    std::size_t free = 0;
+};
+
+
+/*
+ * Linux slab style object cache: a slab is one upstream allocation of PerSlab objects, all default constructed
+ * when the slab is made. acquire() hands out a constructed object, release() takes it back *without* destroying
+ * it, so an expensive constructor(buffers, tables...) runs once per object instead of once per use. the caller
+ * resets whatever per use state the object has. objects are destroyed with the cache, all must be released by then.
+ */
+template <class T, std::size_t PerSlab = 64>
+class ObjectCache
+{
+public:
+    explicit ObjectCache(std::pmr::memory_resource* _upstream = std::pmr::get_default_resource()) : upstream(_upstream) {}
+    ObjectCache(const ObjectCache&) = delete;
+    ObjectCache& operator=(const ObjectCache&) = delete;
+    ~ObjectCache()
+    {
+        for(auto* slab : slabs)
+        {
+            for(std::size_t i = 0; i < PerSlab; ++i)
+                slab[i].~T();
+            upstream->deallocate(slab, sizeof(T) * PerSlab, alignof(T));
+        }
+    }
+    T* acquire()
+    {
+        if(freeObjects.empty())
+            grow();
+        auto object = freeObjects.back();       // LIFO: the last released object is the warmest in cache
+        freeObjects.pop_back();
+        return object;
+    }
+    void release(T* object) { freeObjects.push_back(object); }
+    std::size_t slabCount() const { return slabs.size(); }
+private:
+    void grow()
+    {
+        auto slab = static_cast<T*>(upstream->allocate(sizeof(T) * PerSlab, alignof(T)));
+        std::size_t built = 0;
+        try
+        {
+            for(; built < PerSlab; ++built)
+                ::new(slab + built) T();
+        }
+        catch(...)
+        {
+            while(built-- > 0)
+                slab[built].~T();
+            upstream->deallocate(slab, sizeof(T) * PerSlab, alignof(T));
+            throw;
+        }
+        slabs.push_back(slab);
+        for(std::size_t i = PerSlab; i-- > 0;)
+            freeObjects.push_back(slab + i);
+    }
+    std::pmr::memory_resource* upstream;
+    std::vector<T*> slabs;
+    std::vector<T*> freeObjects;
+};
+
+
+/*
+ * tcmalloc style: size classes 16, 32, ... 1024 bytes. every thread keeps a free list per class, the hot path
+ * is a pop/push on it with no lock. only when a thread's list runs empty(or grows past 2 * batch) a batch of
+ * blocks moves from(to) the central list under one mutex. a block may be freed by another thread than the one
+ * that allocated it, it simply joins that thread's list. bigger or over aligned requests go to upstream.
+ * one process wide instance, its chunks are never given back.
+ */
+class PerThreadPool : public std::pmr::memory_resource
+{
+public:
+    static PerThreadPool& instance()
+    {
+        // never destroyed: exiting threads(and other statics) may still free into it during shutdown
+        static auto* pool = new PerThreadPool();
+        return *pool;
+    }
+    PerThreadPool(const PerThreadPool&) = delete;
+    PerThreadPool& operator=(const PerThreadPool&) = delete;
+    static constexpr std::size_t maxBlock = 1024;
+private:
+    static constexpr std::size_t classes = 7;
+    static constexpr std::size_t batch = 32;
+    static constexpr std::size_t chunkSize = 256 * 1024;
+
+    struct Node
+    {
+        Node* next;
+    };
+    struct FreeList
+    {
+        Node* head = nullptr;
+        std::size_t count = 0;
+        void push(Node* node)
+        {
+            node->next = head;
+            head = node;
+            ++count;
+        }
+        Node* pop()
+        {
+            auto node = head;
+            head = node->next;
+            --count;
+            return node;
+        }
+    };
+    // a thread's lists go back to the central lists when the thread exits
+    struct Cache
+    {
+        FreeList lists[classes];
+        ~Cache() { PerThreadPool::instance().flush(*this); }
+    };
+
+    PerThreadPool() = default;
+    // the plain pointer skips the init/destructor guard of the thread_local Cache on every call
+    static Cache& cache()
+    {
+        static thread_local Cache* fast = nullptr;
+        if(fast == nullptr)
+        {
+            thread_local Cache local;
+            fast = &local;
+        }
+        return *fast;
+    }
+    // 1..16 -> 0, 17..32 -> 1, ... 513..1024 -> 6
+    static std::size_t classOf(std::size_t bytes)
+    {
+        return static_cast<std::size_t>(std::bit_width((bytes - 1) | 15)) - 4;
+    }
+
+    void* do_allocate(std::size_t bytes, std::size_t align) override
+    {
+        if(bytes > maxBlock || align > alignof(std::max_align_t))
+            return std::pmr::new_delete_resource()->allocate(bytes, align);
+        auto c = classOf(bytes == 0 ? 1 : bytes);
+        auto& list = cache().lists[c];
+        if(list.head == nullptr)
+            refill(c, list);
+        return list.pop();
+    }
+    void do_deallocate(void* p, std::size_t bytes, std::size_t align) override
+    {
+        if(bytes > maxBlock || align > alignof(std::max_align_t))
+            return std::pmr::new_delete_resource()->deallocate(p, bytes, align);
+        auto c = classOf(bytes == 0 ? 1 : bytes);
+        auto& list = cache().lists[c];
+        list.push(static_cast<Node*>(p));
+        if(list.count > 2 * batch)
+        {
+            std::lock_guard<std::mutex> lk(lock);
+            for(std::size_t i = 0; i < batch; ++i)
+                central[c].push(list.pop());
+        }
+    }
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+
+    void refill(std::size_t c, FreeList& list)
+    {
+        std::lock_guard<std::mutex> lk(lock);
+        while(list.count < batch && central[c].head != nullptr)
+            list.push(central[c].pop());
+        auto size = std::size_t{16} << c;
+        while(list.count < batch)
+        {
+            if(static_cast<std::size_t>(end - ptr) < size)
+            {
+                // the tail of the old chunk is lost, at most 1KB per 256KB
+                ptr = static_cast<char*>(std::pmr::new_delete_resource()->allocate(chunkSize, alignof(std::max_align_t)));
+                end = ptr + chunkSize;
+            }
+            list.push(::new(ptr) Node{nullptr});
+            ptr += size;
+        }
+    }
+    void flush(Cache& local)
+    {
+        std::lock_guard<std::mutex> lk(lock);
+        for(std::size_t c = 0; c < classes; ++c)
+            while(local.lists[c].head != nullptr)
+                central[c].push(local.lists[c].pop());
+    }
+
+    std::mutex lock;                    // guards central, ptr and end
+    FreeList central[classes];
+    char* ptr = nullptr;                // carving position in the current chunk
+    char* end = nullptr;
+};
+
+} // namespace zeroalloc
@@ -0,0 +1,228 @@
+#pragma once
+
+#include <cstddef>
+#include <cerrno>
+#include <memory>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*
+ * move a whole file to another fd(socket, pipe, file) with as few copies through user space as possible.
+ * + Sendfile:  file -> out inside the kernel, no user space buffer at all
+ * + Splice:    file -> pipe -> out, page references move through the pipe(out may itself be the pipe)
+ * + Mmap:      the file is mapped, write() copies straight from the page cache mapping: one copy instead of two
+ * + ReadWrite: the naive loop, read() into a buffer and write() it out again(two copies)
+ * transfer() starts at the preferred method and falls back down this list when the kernel refuses one
+ * (EINVAL/ENOSYS/...) before any byte was sent. linux only.
+ */
+namespace zerocopy
+{
+
+enum class Method { Sendfile, Splice, Mmap, ReadWrite };
+
+inline const char* name(Method method)
+{
+    switch(method)
+    {
+    case Method::Sendfile: return "sendfile";
+    case Method::Splice: return "splice";
+    case Method::Mmap: return "mmap+write";
+    case Method::ReadWrite: return "read/write";
+    }
+    return "?";
+}
+
+struct Result
+{
+    std::size_t bytes = 0;
+    Method method = Method::ReadWrite;     // the one that did the work
+    int error = 0;                         // errno of the failure, 0 when the whole file went out
+};
+
+namespace detail
+{
+
+constexpr std::size_t chunk = 1 << 20;
+
+// the method does not apply to this pair of fds, try the next one
+inline bool unsupported(int error)
+{
+    return error == EINVAL || error == ENOSYS || error == EOPNOTSUPP || error == ENODEV || error == EXDEV;
+}
+
+inline bool writeAll(int out, const char* data, std::size_t size, Result& result)
+{
+    while(size != 0)
+    {
+        auto n = ::write(out, data, size);
+        if(n < 0 && errno == EINTR)
+            continue;
+        if(n <= 0)
+        {
+            result.error = n < 0 ? errno : EIO;
+            return false;
+        }
+        data += n;
+        size -= static_cast<std::size_t>(n);
+        result.bytes += static_cast<std::size_t>(n);
+    }
+    return true;
+}
+
+inline Result viaSendfile(int in, int out)
+{
+    Result result{0, Method::Sendfile, 0};
+    off_t offset = 0;
+    while(true)
+    {
+        auto n = ::sendfile(out, in, &offset, chunk);
+        if(n < 0 && errno == EINTR)
+            continue;
+        if(n < 0)
+        {
+            result.error = errno;
+            return result;
+        }
+        if(n == 0)
+            return result;
+        result.bytes += static_cast<std::size_t>(n);
+    }
+}
+
+// splice needs a pipe on one side: use `out` if it is one, otherwise a private pipe in between
+inline Result viaSplice(int in, int out)
+{
+    Result result{0, Method::Splice, 0};
+    struct stat st;
+    if(::fstat(out, &st) != 0)
+    {
+        result.error = errno;
+        return result;
+    }
+    int pipefd[2] = {-1, -1};
+    bool direct = S_ISFIFO(st.st_mode);
+    if(!direct)
+    {
+        if(::pipe2(pipefd, O_CLOEXEC) != 0)
+        {
+            result.error = errno;
+            return result;
+        }
+        ::fcntl(pipefd[1], F_SETPIPE_SZ, static_cast<int>(chunk));     // best effort, fewer round trips
+    }
+    int target = direct ? out : pipefd[1];
+    loff_t offset = 0;
+    while(true)
+    {
+        auto n = ::splice(in, &offset, target, nullptr, chunk, SPLICE_F_MOVE | SPLICE_F_MORE);
+        if(n < 0 && errno == EINTR)
+            continue;
+        if(n <= 0)
+        {
+            result.error = n < 0 ? errno : 0;
+            break;
+        }
+        if(direct)
+        {
+            result.bytes += static_cast<std::size_t>(n);
+            continue;
+        }
+        // drain what we just put into the private pipe
+        for(auto left = n; left != 0;)
+        {
+            auto m = ::splice(pipefd[0], nullptr, out, nullptr, static_cast<std::size_t>(left), SPLICE_F_MOVE | SPLICE_F_MORE);
+            if(m < 0 && errno == EINTR)
+                continue;
+            if(m <= 0)
+            {
+                result.error = m < 0 ? errno : EIO;
+                break;
+            }
+            left -= m;
+            result.bytes += static_cast<std::size_t>(m);
+        }
+        if(result.error != 0)
+            break;
+    }
+    if(!direct)
+    {
+        ::close(pipefd[0]);
+        ::close(pipefd[1]);
+    }
+    return result;
+}
+
+inline Result viaMmap(int in, int out)
+{
+    Result result{0, Method::Mmap, 0};
+    struct stat st;
+    if(::fstat(in, &st) != 0)
+    {
+        result.error = errno;
+        return result;
+    }
+    if(!S_ISREG(st.st_mode))
+    {
+        result.error = EINVAL;
+        return result;
+    }
+    auto size = static_cast<std::size_t>(st.st_size);
+    if(size == 0)
+        return result;
+    void* map = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, in, 0);
+    if(map == MAP_FAILED)
+    {
+        result.error = errno;
+        return result;
+    }
+    ::madvise(map, size, MADV_SEQUENTIAL);
+    detail::writeAll(out, static_cast<const char*>(map), size, result);
+    ::munmap(map, size);
+    return result;
+}
+
+inline Result viaReadWrite(int in, int out)
+{
+    Result result{0, Method::ReadWrite, 0};
+    auto buffer = std::make_unique<char[]>(chunk);
+    while(true)
+    {
+        auto n = ::read(in, buffer.get(), chunk);
+        if(n < 0 && errno == EINTR)
+            continue;
+        if(n < 0)
+        {
+            result.error = errno;
+            return result;
+        }
+        if(n == 0 || !detail::writeAll(out, buffer.get(), static_cast<std::size_t>(n), result))
+            return result;
+    }
+}
+
+} // namespace detail
+
+// `in` is read from offset 0 to the end, its file offset is left alone(except by ReadWrite)
+inline Result transfer(int in, int out, Method preferred = Method::Sendfile)
+{
+    Result result;
+    for(int m = static_cast<int>(preferred); m <= static_cast<int>(Method::ReadWrite); ++m)
+    {
+        switch(static_cast<Method>(m))
+        {
+        case Method::Sendfile: result = detail::viaSendfile(in, out); break;
+        case Method::Splice: result = detail::viaSplice(in, out); break;
+        case Method::Mmap: result = detail::viaMmap(in, out); break;
+        case Method::ReadWrite: result = detail::viaReadWrite(in, out); break;
+        }
+        if(result.error == 0 || result.bytes != 0 || !detail::unsupported(result.error))
+            return result;
+    }
+    return result;
+}
+
+} // namespace zerocopy